@@ -0,0 +1,28 @@
+// writes a seeded synthetic Crno program to stdout, one top-level form per line,
+// ready for batch mode. settings are the ones bench/gen.h takes
+// gcc -std=c99 -O2 -Isrc -o bin/crnogen bench/crnogen.c bench/gen.c src/fmt.c -lm
+// ./bin/crnogen [settings] [forms] > prog.crno, e.g. ./bin/crnogen deep,depth=64,seed=7 1000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gen.h"
+
+int main(int argc, char** argv){
+  gen_params g;
+  gen_defaults(&g);
+  if(argc > 1 && !gen_set(&g, argv[1])){
+    fprintf(stderr, "crnogen: bad settings %s\n", argv[1]);
+    return 2;
+  }
+  int n = argc > 2 ? atoi(argv[2]) : 1000;
+
+  fmt_buf b = { NULL, 0, 0 };
+  for(int i = 0; i < n; i++){
+    gen_form(&g, &b);
+    fmt_putc(&b, '\n');
+    if(b.len >= 65536 && fmt_flush(&b, 1) < 0) return 1;
+  }
+  int status = fmt_flush(&b, 1) < 0;
+  fmt_free(&b);
+  return status;
+}
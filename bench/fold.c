@@ -0,0 +1,77 @@
+// checks --fold prints the same thing as evaluating the form as read, for forms
+// that hit each rewrite in lval_fold, ints near 2^53 mixed with floats, errors
+// raised before and after a merge, and float sums either side of REDUCE_MIN
+// make bench, or gcc -std=c99 -O2 -pthread -Isrc -o bin/fold bench/fold.c src/mpc.c src/fmt.c src/simd.c src/pool.c src/mem.c -lm
+// ./bin/fold
+
+#define CRNO_NO_MAIN
+#include "parsing.c"
+
+static const char* forms[] = {
+  "(+ (+ 9007199254740993 (* 1 (fold + 0 {1}))) 0.5)",
+  "(+ (+ 9007199254740993 (* 1 (fold + 0 {1}))) 1)",
+  "(+ (+ 9007199254740993 0.5 (* 1 (fold + 0 {1}))) 1)",
+  "(* (* 3037000500 (* 1 (fold + 0 {3037000500}))) 0.5)",
+  "(* (* 4611686018427387904 (* 1 (fold + 0 {2}))) 3)",
+  "(min (min 9007199254740993 (* 1 (fold + 0 {1}))) 9007199254740992.0)",
+  "(max (max -0 (* 1 (fold + 0 {0}))) 0)",
+  "(+ (+ 1 (* 1 (fold + 0 {1}))) (/ 1 0))",
+  "(+ (+ 1 (/ 1 0)) {1})",
+  "(+ (+ 0.1 (* 1 (fold + 0 {1}))) 0.2 0.3 0.4 0.5 0.6 0.7 0.8 0.9 1.1 1.2 1.3 1.4 1.5 1.6 1.7 1.8 1.9)",
+  "(+ 1 2.5)",
+  "(% 7 -0)",
+  "(- 9007199254740993 0.5)",
+  "(head (list 1 2 (+ 1 2)))",
+  "(eval {+ 1 (eval {* 2 3})})",
+  "((+ 1 2))",
+};
+
+// what the form prints when it's read, maybe folded, then evaluated
+static char* run(mpc_ast_t* t, int fold){
+  lval* x = lval_read(t);
+  if(fold) x = lval_fold(x);
+  x = lval_eval(x);
+  fmt_buf b = { NULL, 0, 0 };
+  lval_write(&b, x);
+  fmt_putc(&b, '\0');
+  lval_del(x);
+  return b.data;
+}
+
+int main(void){
+  int n = sizeof(forms) / sizeof(forms[0]);
+  int bad = 0;
+  cache_on = 0;
+
+  mpc_parser_t* Num = mpc_new("num");
+  mpc_parser_t* Sym = mpc_new("sym");
+  mpc_parser_t* Sexpr = mpc_new("sexpr");
+  mpc_parser_t* Qexpr = mpc_new("qexpr");
+  mpc_parser_t* Expr = mpc_new("expr");
+  mpc_parser_t* Crno = mpc_new("crno");
+  lval_err_init();
+  builtin_init();
+  char* lang = builtin_grammar(crno_lang);
+  mpca_lang(MPCA_LANG_DEFAULT, lang, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  free(lang);
+
+  for(int i = 0; i < n; i++){
+    mpc_result_t r;
+    if(!mpc_parse("<fold>", forms[i], Crno, &r)){
+      mpc_err_print(r.error);
+      mpc_err_delete(r.error);
+      bad++;
+      continue;
+    }
+    char* want = run(r.output, 0);
+    char* got = run(r.output, 1);
+    if(strcmp(want, got) != 0 && bad++ < 10) printf("%s folds to %s, evaluates to %s\n", forms[i], got, want);
+    free(want);
+    free(got);
+    mpc_ast_delete(r.output);
+  }
+
+  printf("fold     %s, %d forms, %d differ\n", bad ? "FAILED" : "ok", n, bad);
+  mpc_cleanup(6, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gen.h"
+
+// the corpora bench/stages started out with, as settings
+static const char* gen_presets[][2] = {
+  { "wide",    "width=256,depth=1,fanout=0,nums=mix,mix=arith:1/list:0/vec:0/hof:0" },
+  { "deep",    "width=2,depth=128,fanout=1,nums=mix,mix=arith:1/list:0/vec:0/hof:0" },
+  { "qexpr",   "width=2,depth=8,fanout=2,len=16,nums=mix,mix=arith:0/list:1/vec:0/hof:0" },
+  { "numbers", "width=256,depth=1,fanout=0,len=256,nums=long,mix=arith:0/list:1/vec:0/hof:0" },
+};
+
+static const char* gen_kind_names[GEN_KINDS] = { "arith", "list", "vec", "hof" };
+
+void gen_defaults(gen_params* g){
+  g->seed = 0x9E3779B97F4A7C15ULL;
+  g->width = 8;
+  g->depth = 3;
+  g->fanout = 1;
+  g->len = 8;
+  g->nums = GEN_MIX;
+  g->mix[GEN_ARITH] = 4;
+  g->mix[GEN_LIST] = 2;
+  g->mix[GEN_VEC] = 1;
+  g->mix[GEN_HOF] = 1;
+}
+
+static int gen_setting(gen_params* g, const char* key, const char* val){
+  if(strcmp(key, "seed") == 0){
+    g->seed = strtoull(val, NULL, 10);
+    if(!g->seed) g->seed = 1; // xorshift never leaves 0
+    return 1;
+  }
+  if(strcmp(key, "width") == 0){ g->width = atoi(val); return g->width >= 0; }
+  if(strcmp(key, "depth") == 0){ g->depth = atoi(val); return g->depth >= 0; }
+  if(strcmp(key, "fanout") == 0){ g->fanout = atoi(val); return g->fanout >= 0; }
+  if(strcmp(key, "len") == 0){ g->len = atoi(val); return g->len >= 0; }
+  if(strcmp(key, "nums") == 0){
+    const char* names[] = { "int", "dec", "long", "mix" };
+    for(int i = 0; i < 4; i++) if(strcmp(val, names[i]) == 0){ g->nums = i; return 1; }
+    return 0;
+  }
+  if(strcmp(key, "mix") == 0){
+    // kind:weight pairs split by '/', kinds left out keep their weight
+    char name[16];
+    int w, n;
+    while(sscanf(val, "%15[a-z]:%d%n", name, &w, &n) == 2){
+      int k = 0;
+      while(k < GEN_KINDS && strcmp(name, gen_kind_names[k]) != 0) k++;
+      if(k == GEN_KINDS || w < 0) return 0;
+      g->mix[k] = w;
+      val += n;
+      if(*val != '/') break;
+      val++;
+    }
+    return *val == '\0';
+  }
+  return 0;
+}
+
+int gen_set(gen_params* g, const char* spec){
+  char tok[256];
+  while(*spec){
+    size_t n = strcspn(spec, ",");
+    if(n >= sizeof(tok)) return 0;
+    memcpy(tok, spec, n);
+    tok[n] = '\0';
+    spec += n + (spec[n] == ',');
+    if(!n) continue;
+
+    char* eq = strchr(tok, '=');
+    if(eq){
+      *eq = '\0';
+      if(!gen_setting(g, tok, eq+1)) return 0;
+      continue;
+    }
+    int p = 0, presets = sizeof(gen_presets) / sizeof(gen_presets[0]);
+    while(p < presets && strcmp(tok, gen_presets[p][0]) != 0) p++;
+    if(p == presets || !gen_set(g, gen_presets[p][1])) return 0;
+  }
+  return 1;
+}
+
+static unsigned long long gen_rnd(gen_params* g){
+  g->seed ^= g->seed << 13;
+  g->seed ^= g->seed >> 7;
+  g->seed ^= g->seed << 17;
+  return g->seed;
+}
+
+// a call kind by weight, arith if every weight is 0
+static int gen_pick(gen_params* g){
+  int total = 0;
+  for(int k = 0; k < GEN_KINDS; k++) total += g->mix[k];
+  if(total <= 0) return GEN_ARITH;
+  int r = (int)(gen_rnd(g) % total);
+  for(int k = 0; k < GEN_KINDS; k++){
+    if(r < g->mix[k]) return k;
+    r -= g->mix[k];
+  }
+  return GEN_ARITH;
+}
+
+// whether arg i of n nests, left of them still have to. a uniform pick of fanout args
+static int gen_nest(gen_params* g, int i, int n, int* left){
+  if(*left > 0 && (int)(gen_rnd(g) % (n - i)) < *left){
+    (*left)--;
+    return 1;
+  }
+  return 0;
+}
+
+// the num rule has no exponents, so doubles are written out by hand
+static void gen_lit(gen_params* g, fmt_buf* b){
+  static const int mixed[] = { GEN_INT, GEN_INT, GEN_DEC, GEN_LONG };
+  char s[64];
+  int nums = g->nums == GEN_MIX ? mixed[gen_rnd(g) % 4] : g->nums;
+  switch(nums){
+    case GEN_INT: snprintf(s, sizeof(s), "%d", (int)(gen_rnd(g) % 1000)); break;
+    case GEN_DEC: snprintf(s, sizeof(s), "%d.%02d", (int)(gen_rnd(g) % 1000), (int)(gen_rnd(g) % 100)); break;
+    default:
+      switch(gen_rnd(g) % 3){
+        case 0: snprintf(s, sizeof(s), "%lld", (long long)(gen_rnd(g) >> 2)); break;
+        case 1: snprintf(s, sizeof(s), "%.9f", (double)(gen_rnd(g) % 1000000000) / 7.0); break;
+        default: snprintf(s, sizeof(s), "0.%015llu", gen_rnd(g) % 1000000000000000ULL); break;
+      }
+  }
+  fmt_puts(b, s);
+}
+
+static void gen_qlit(gen_params* g, fmt_buf* b){
+  fmt_putc(b, '{');
+  for(int i = 0; i < g->len; i++){
+    if(i) fmt_putc(b, ' ');
+    gen_lit(g, b);
+  }
+  fmt_putc(b, '}');
+}
+
+static void gen_vlit(gen_params* g, fmt_buf* b){
+  fmt_puts(b, "(vec");
+  for(int i = 0; i < g->len; i++){
+    fmt_putc(b, ' ');
+    gen_lit(g, b);
+  }
+  fmt_putc(b, ')');
+}
+
+static void gen_num(gen_params* g, fmt_buf* b, int d);
+static void gen_list(gen_params* g, fmt_buf* b, int d);
+static void gen_vec(gen_params* g, fmt_buf* b, int d);
+
+// args of a call, nest ones go a level down through sub and the rest are leaves
+static void gen_args(gen_params* g, fmt_buf* b, int d, int n,
+                     void (*sub)(gen_params*, fmt_buf*, int), void (*leaf)(gen_params*, fmt_buf*)){
+  int left = g->fanout < n ? g->fanout : n;
+  for(int i = 0; i < n; i++){
+    fmt_putc(b, ' ');
+    if(gen_nest(g, i, n, &left)) sub(g, b, d-1);
+    else leaf(g, b);
+  }
+}
+
+// anything that evaluates to a number
+static void gen_num(gen_params* g, fmt_buf* b, int d){
+  static const char* ops[] = { "+", "-", "*", "min", "max" };
+  if(d <= 0){
+    gen_lit(g, b);
+    return;
+  }
+  switch(gen_pick(g)){
+    case GEN_ARITH:
+      fmt_putc(b, '(');
+      fmt_puts(b, ops[gen_rnd(g) % 5]);
+      gen_args(g, b, d, g->width, gen_num, gen_lit);
+      break;
+    case GEN_LIST:
+      fmt_puts(b, "(eval (head");
+      gen_args(g, b, d, 1, gen_list, gen_qlit);
+      fmt_putc(b, ')');
+      break;
+    case GEN_VEC: {
+      int dot = gen_rnd(g) % 2;
+      fmt_puts(b, dot ? "(dot" : "(sum");
+      gen_args(g, b, d, dot ? 2 : 1, gen_vec, gen_vlit);
+      break;
+    }
+    case GEN_HOF:
+      fmt_puts(b, "(fold + 0");
+      gen_args(g, b, d, 1, gen_list, gen_qlit);
+      break;
+  }
+  fmt_putc(b, ')');
+}
+
+// anything that evaluates to a qexpr of numbers
+static void gen_list(gen_params* g, fmt_buf* b, int d){
+  if(d <= 0){
+    gen_qlit(g, b);
+    return;
+  }
+  switch(gen_pick(g)){
+    case GEN_ARITH:
+      fmt_puts(b, "(list");
+      gen_args(g, b, d, g->width, gen_num, gen_lit);
+      break;
+    case GEN_LIST:
+      if(gen_rnd(g) % 2){
+        fmt_puts(b, "(join");
+        gen_args(g, b, d, 2, gen_list, gen_qlit);
+      }else{
+        fmt_puts(b, "(tail");
+        gen_args(g, b, d, 1, gen_list, gen_qlit);
+      }
+      break;
+    case GEN_VEC:
+      fmt_puts(b, "(map {* 2}");
+      gen_args(g, b, d, 1, gen_vec, gen_vlit);
+      break;
+    case GEN_HOF:
+      fmt_puts(b, gen_rnd(g) % 2 ? "(map {* 2}" : "(filter {min 1}");
+      gen_args(g, b, d, 1, gen_list, gen_qlit);
+      break;
+  }
+  fmt_putc(b, ')');
+}
+
+// anything that evaluates to a vec, they all have len elements so they line up
+static void gen_vec(gen_params* g, fmt_buf* b, int d){
+  if(d <= 0 || gen_pick(g) != GEN_VEC){
+    gen_vlit(g, b);
+    return;
+  }
+  fmt_puts(b, gen_rnd(g) % 2 ? "(vadd" : "(vmul");
+  gen_args(g, b, d, 2, gen_vec, gen_vlit);
+  fmt_putc(b, ')');
+}
+
+void gen_form(gen_params* g, fmt_buf* b){
+  int k = gen_pick(g);
+  if(k == GEN_ARITH || k == GEN_VEC) gen_num(g, b, g->depth);
+  else gen_list(g, b, g->depth);
+}
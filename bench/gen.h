@@ -0,0 +1,33 @@
+#ifndef gen_h
+#define gen_h
+
+#include "fmt.h"
+
+// seeded generator of well typed Crno programs, for scaling runs of the benchmarks
+
+enum gen_nums { GEN_INT, GEN_DEC, GEN_LONG, GEN_MIX };
+
+// kinds of call the generator picks between, weighted by mix
+enum gen_kinds { GEN_ARITH, GEN_LIST, GEN_VEC, GEN_HOF, GEN_KINDS };
+
+typedef struct gen_params {
+  unsigned long long seed; // current state, every form moves it on
+  int width;  // args of a call, elements of (list ...)
+  int depth;  // calls nested under the top-level one
+  int fanout; // args of a call that nest further, the rest are literals
+  int len;    // elements of {...} and (vec ...) literals
+  int nums;   // one of gen_nums
+  int mix[GEN_KINDS];
+} gen_params;
+
+void gen_defaults(gen_params* g);
+
+// applies comma separated settings left to right: seed=, width=, depth=, fanout=, len=,
+// nums=int|dec|long|mix and mix=arith:4/list:1/vec:0/hof:1. a bare word is a preset,
+// wide, deep, qexpr or numbers. returns 0 and leaves the rest alone at the first bad one
+int gen_set(gen_params* g, const char* spec);
+
+// one top-level form onto b, no newline
+void gen_form(gen_params* g, fmt_buf* b);
+
+#endif
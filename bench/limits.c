@@ -0,0 +1,78 @@
+// checks --max-time and --max-mem stop a single builtin that runs long or allocates
+// a lot without reducing, well before it would finish on its own
+// make bench, or gcc -std=c99 -O2 -pthread -Isrc -o bin/limits bench/limits.c src/mpc.c src/fmt.c src/simd.c src/pool.c src/mem.c -lm
+// ./bin/limits [elements]
+
+#define CRNO_NO_MAIN
+#include "parsing.c"
+
+static lval* iota(int n){
+  lval* q = lval_qexpr();
+  for(int i = 0; i < n; i++) q = lval_add(q, lval_int(i));
+  return q;
+}
+
+static lval* iota_vec(int n){
+  lval* v = lval_vec(n);
+  for(int i = 0; i < n; i++) v->vec[i] = i;
+  return v;
+}
+
+// (join x y) under whatever limits are set, the result and the time it took
+static lval* join(lval* x, lval* y, double* secs){
+  lval* v = lval_sexpr();
+  v = lval_add(v, lval_sym("join"));
+  v = lval_add(v, x);
+  v = lval_add(v, y);
+
+  eval_limits l;
+  eval_limits* outer = limit_begin(&l);
+  int64_t t = now_ns();
+  v = lval_eval(v);
+  *secs = (now_ns() - t) / 1e9;
+  limits = outer;
+  return v;
+}
+
+static int expect(const char* name, lval* v, int code, double secs, double most){
+  int ok = v->type == LVAL_ERR && v->code == code && secs < most;
+  printf("%-8s %s in %.3fs", name, ok ? "ok" : "FAILED", secs);
+  if(!ok && v->type == LVAL_ERR) printf(", got error %d", v->code);
+  else if(!ok) printf(", got a result with %d elements", v->count);
+  printf("\n");
+  lval_del(v);
+  return ok;
+}
+
+int main(int argc, char** argv){
+  int n = argc > 1 ? atoi(argv[1]) : 200000;
+  double secs;
+  int ok = 1;
+  lval* v;
+  lval_err_init();
+  builtin_init();
+  cache_on = 0;
+
+  // pops from the front, so this is quadratic and takes seconds unchecked
+  max_time = 100;
+  v = join(iota(n), iota(n), &secs);
+  ok &= expect("time", v, LERR_TIME, secs, 1.0);
+  max_time = 0;
+
+  // a vec joined with a list is unpacked into n nums first
+  max_mem = 1 << 20;
+  v = join(iota_vec(n), iota(1), &secs);
+  ok &= expect("memory", v, LERR_MEM, secs, 1.0);
+  max_mem = 0;
+
+  // and one that's well within both still gets its result
+  max_time = 10000;
+  max_mem = 1 << 30;
+  v = join(iota(1000), iota(1000), &secs);
+  int fine = v->type == LVAL_QEXPR && v->count == 2000;
+  printf("%-8s %s in %.3fs\n", "within", fine ? "ok" : "FAILED", secs);
+  lval_del(v);
+  ok &= fine;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+// load generator for crno --serve. every client is a thread with its own connection
+// that sends one form, waits for the reply line and sends the next, so latency is
+// the round trip of a single request. reports requests/s and latency percentiles
+// gcc -std=c99 -O2 -pthread -o bin/loadgen bench/loadgen.c && ./bin/loadgen /tmp/crno.sock [clients] [requests] [form]
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static double now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+typedef struct {
+  const char* path;
+  const char* form;
+  int n;
+  double* lat;
+  char* first;  // the first reply, every later one should match it
+  long bad;
+  int failed;
+} client;
+
+// reads up to and including the next newline into line, 0 if the server went away
+static int read_line(int fd, char* buf, size_t* len, char* line, size_t cap){
+  for(;;){
+    char* nl = memchr(buf, '\n', *len);
+    if(nl){
+      size_t n = nl - buf + 1;
+      size_t k = n < cap ? n : cap - 1;
+      memcpy(line, buf, k);
+      line[k] = '\0';
+      memmove(buf, buf + n, *len - n);
+      *len -= n;
+      return 1;
+    }
+    if(*len == 4096) *len = 0; // a reply longer than this isn't worth keeping
+    ssize_t r = read(fd, buf + *len, 4096 - *len);
+    if(r <= 0) return 0;
+    *len += r;
+  }
+}
+
+static void* run(void* arg){
+  client* c = arg;
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, c->path, sizeof(addr.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+    c->failed = 1;
+    if(fd >= 0) close(fd);
+    return NULL;
+  }
+
+  size_t flen = strlen(c->form);
+  char* req = malloc(flen + 2);
+  memcpy(req, c->form, flen);
+  req[flen] = '\n';
+  char buf[4096], line[4096];
+  size_t len = 0;
+
+  for(int i = 0; i < c->n; i++){
+    double t0 = now();
+    size_t off = 0;
+    while(off < flen + 1){
+      ssize_t w = write(fd, req + off, flen + 1 - off);
+      if(w <= 0){
+        c->failed = 1;
+        break;
+      }
+      off += w;
+    }
+    if(c->failed || !read_line(fd, buf, &len, line, sizeof(line))){
+      c->failed = 1;
+      c->n = i;
+      break;
+    }
+    c->lat[i] = now() - t0;
+    if(!c->first) c->first = strdup(line);
+    else if(strcmp(c->first, line) != 0) c->bad++;
+  }
+
+  free(req);
+  close(fd);
+  return NULL;
+}
+
+static int cmp(const void* a, const void* b){
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv){
+  if(argc < 2){
+    fprintf(stderr, "usage: %s socket [clients] [requests] [form]\n", argv[0]);
+    return 2;
+  }
+  int clients = argc > 2 ? atoi(argv[2]) : 16;
+  int n = argc > 3 ? atoi(argv[3]) : 10000;
+  const char* form = argc > 4 ? argv[4] : "(+ 1 (* 2 3) (- 10 4))";
+  if(clients < 1) clients = 1;
+  if(n < 1) n = 1;
+
+  pthread_t* tids = malloc(sizeof(pthread_t) * clients);
+  client* cs = calloc(clients, sizeof(client));
+
+  double t0 = now();
+  for(int i = 0; i < clients; i++){
+    cs[i] = (client){ argv[1], form, n, malloc(sizeof(double) * n), NULL, 0, 0 };
+    pthread_create(&tids[i], NULL, run, &cs[i]);
+  }
+  for(int i = 0; i < clients; i++) pthread_join(tids[i], NULL);
+  double elapsed = now() - t0;
+
+  // every client's latencies in one sorted list
+  long total = 0, bad = 0;
+  int failed = 0;
+  for(int i = 0; i < clients; i++) total += cs[i].n;
+  double* lat = malloc(sizeof(double) * (total ? total : 1));
+  long k = 0;
+  for(int i = 0; i < clients; i++){
+    memcpy(lat + k, cs[i].lat, sizeof(double) * cs[i].n);
+    k += cs[i].n;
+    failed += cs[i].failed;
+    bad += cs[i].bad;
+    // replies should agree across clients too, not just within one
+    if(cs[i].first && cs[0].first && strcmp(cs[i].first, cs[0].first) != 0) bad++;
+  }
+  qsort(lat, total, sizeof(double), cmp);
+
+  if(cs[0].first) printf("reply     %s", cs[0].first);
+  printf("clients   %d\n", clients);
+  printf("requests  %ld\n", total);
+  printf("req/s     %.0f\n", total / elapsed);
+  if(total){
+    double ps[] = { 0.5, 0.9, 0.99, 0.999 };
+    const char* names[] = { "p50", "p90", "p99", "p99.9" };
+    for(int i = 0; i < 4; i++){
+      long j = (long)(ps[i] * (total - 1));
+      printf("%-9s %.1f us\n", names[i], lat[j] * 1e6);
+    }
+    printf("max       %.1f us\n", lat[total-1] * 1e6);
+  }
+  printf("mismatch  %ld\n", bad);
+  if(failed) printf("failed    %d clients\n", failed);
+
+  for(int i = 0; i < clients; i++){
+    free(cs[i].lat);
+    free(cs[i].first);
+  }
+  free(cs);
+  free(tids);
+  free(lat);
+  return failed || bad ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+// the same calls evaluated over and over with the memo cache off and on, to show
+// which builtins it pays for. every call is one of a few distinct forms, so after
+// the first round every lookup with --cache is a hit
+// make bench, or gcc -std=c99 -O2 -pthread -Isrc -o bin/memo bench/memo.c src/mpc.c src/fmt.c src/simd.c src/pool.c src/mem.c -lm
+// ./bin/memo [calls]
+
+#define CRNO_NO_MAIN
+#include "parsing.c"
+
+#define MEMO_DISTINCT 16 // distinct forms per row, all of them fit in the cache
+
+// (f x+0 x+step ... ) with n args, every distinct form i starts at a different x
+static lval* call(const char* f, int n, double x, double step, int ints){
+  lval* v = lval_sexpr();
+  v = lval_add(v, lval_sym((char*)f));
+  for(int i = 0; i < n; i++) v = lval_add(v, ints ? lval_int((int64_t)(x + i*step)) : lval_num(x + i*step));
+  return v;
+}
+
+// {x x+1 ...}
+static lval* list(int n, int x){
+  lval* q = lval_qexpr();
+  for(int i = 0; i < n; i++) q = lval_add(q, lval_int(x + i));
+  return q;
+}
+
+static lval* wrap(const char* f, lval* x, lval* y){
+  lval* v = lval_sexpr();
+  v = lval_add(v, lval_sym((char*)f));
+  v = lval_add(v, x);
+  if(y) v = lval_add(v, y);
+  return v;
+}
+
+static double run(lval** forms, int calls, int on){
+  cache_on = on;
+  int64_t t = now_ns();
+  for(int i = 0; i < calls; i++) lval_del(lval_eval(lval_copy(forms[i % MEMO_DISTINCT])));
+  return (double)(now_ns() - t) / calls;
+}
+
+int main(int argc, char** argv){
+  int calls = argc > 1 ? atoi(argv[1]) : 200000;
+  lval_err_init();
+  builtin_init();
+
+  const char* names[] = {
+    "(+ int int)", "(+ num num)", "(* 32 nums)", "(list 64 ints)",
+    "(head {64})", "(join {64} {64})", "(^ 32 nums)", "(% 1e300 32 nums)"
+  };
+  int rows = sizeof(names) / sizeof(names[0]);
+
+  printf("%-20s %12s %12s %8s\n", "call", "off ns", "--cache ns", "speedup");
+  for(int r = 0; r < rows; r++){
+    lval* forms[MEMO_DISTINCT];
+    for(int i = 0; i < MEMO_DISTINCT; i++){
+      switch(r){
+        case 0: forms[i] = call("+", 2, i, 1, 1); break;
+        case 1: forms[i] = call("+", 2, i + 0.5, 1, 0); break;
+        case 2: forms[i] = call("*", 32, 1 + i * 1e-3, 1e-4, 0); break;
+        case 3: forms[i] = call("list", 64, i, 1, 1); break;
+        case 4: forms[i] = wrap("head", list(64, i), NULL); break;
+        case 5: forms[i] = wrap("join", list(64, i), list(64, i)); break;
+        case 6: forms[i] = call("^", 32, 1 + i * 1e-3, 1e-4, 0); break;
+        default:
+          forms[i] = call("%", 32, 3 + i, 1.0 / 3, 0);
+          forms[i]->cell[1]->num = 1e300;
+          break;
+      }
+    }
+
+    // a round of each first so neither side pays for warming up
+    run(forms, MEMO_DISTINCT, 0);
+    double off = run(forms, calls, 0);
+    run(forms, MEMO_DISTINCT, 1);
+    double on = run(forms, calls, 1);
+    printf("%-20s %12.1f %12.1f %7.2fx\n", names[r], off, on, off / on);
+
+    for(int i = 0; i < MEMO_DISTINCT; i++) lval_del(forms[i]);
+  }
+  return 0;
+}
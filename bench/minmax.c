@@ -0,0 +1,73 @@
+// checks min and max give the same bits as the plain left to right loop at every
+// length around REDUCE_MIN, where builtin_op switches to the simd kernels, with
+// nan, 0, -0 and infinities mixed in at random places
+// make bench, or gcc -std=c99 -O2 -pthread -Isrc -o bin/minmax bench/minmax.c src/mpc.c src/fmt.c src/simd.c src/pool.c src/mem.c -lm
+// ./bin/minmax [rounds]
+
+#define CRNO_NO_MAIN
+#include "parsing.c"
+
+static unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long rnd(void){
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+// mostly small values so ties are common, the awkward ones one time in eight
+static double pick(void){
+  switch(rnd() % 32){
+    case 0: return NAN;
+    case 1: return 0.0;
+    case 2: return -0.0;
+    case 3: return HUGE_VAL;
+    case 4: return -HUGE_VAL;
+  }
+  return (double)(rnd() % 7) - 3;
+}
+
+// what builtin_op does below REDUCE_MIN and with --strict-fp
+static double serial(int op, double* xs, int n){
+  double x = xs[0];
+  for(int i = 1; i < n; i++){
+    if(op == LOP_MIN) x = xs[i] < x ? xs[i] : x;
+    else x = xs[i] > x ? xs[i] : x;
+  }
+  return x;
+}
+
+static double eval(int op, double* xs, int n){
+  lval* v = lval_sexpr();
+  v = lval_add(v, lval_sym(lop_names[op]));
+  for(int i = 0; i < n; i++) v = lval_add(v, lval_num(xs[i]));
+  v = lval_eval(v);
+  double x = v->type == LVAL_NUM ? v->num : 12345;
+  lval_del(v);
+  return x;
+}
+
+int main(int argc, char** argv){
+  int rounds = argc > 1 ? atoi(argv[1]) : 200;
+  int bad = 0;
+  long checked = 0;
+  double xs[REDUCE_MIN * 4];
+  lval_err_init();
+  builtin_init();
+
+  for(int r = 0; r < rounds; r++){
+    for(int n = 2; n <= REDUCE_MIN * 4; n++){
+      for(int i = 0; i < n; i++) xs[i] = pick();
+      for(int op = LOP_MIN; op <= LOP_MAX; op++){
+        double want = serial(op, xs, n), got = eval(op, xs, n);
+        checked++;
+        if(memcmp(&want, &got, sizeof(double)) == 0) continue;
+        if(bad++ < 10) printf("%s over %d args: got %g, the loop gives %g\n", lop_names[op], n, got, want);
+      }
+    }
+  }
+
+  printf("minmax   %s, %ld calls on %s, %d differ\n", bad ? "FAILED" : "ok", checked, simd_isa(), bad);
+  return bad ? 1 : 0;
+}
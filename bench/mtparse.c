@@ -0,0 +1,180 @@
+// parses one corpus from many threads at once against a single shared grammar and
+// checks every result is identical to a single threaded run
+// make bench, or gcc -std=c99 -O2 -pthread -Isrc -o bin/mtparse bench/mtparse.c src/mpc.c src/fmt.c src/simd.c src/pool.c src/mem.c -lm
+// ./bin/mtparse [threads] [n]
+
+#define CRNO_NO_MAIN
+#include "parsing.c"
+
+#include <pthread.h>
+
+static unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long rnd(void){
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+static double now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// some of the registered builtins, what the corpus calls
+static const char* syms[] = { "+", "-", "*", "/", "min", "max", "list", "join", "head", "sum", "vadd", "dot" };
+
+static void gen_expr(char* buf, size_t* len, size_t cap, int depth){
+  int k = (int)(rnd() % 8);
+  if(*len + 64 > cap) k = 0;
+  if(depth > 4 || k < 3){
+    *len += snprintf(buf + *len, cap - *len, "%d.%d ", (int)(rnd() % 1000), (int)(rnd() % 100));
+  }else if(k < 4){
+    *len += snprintf(buf + *len, cap - *len, "%s ", syms[rnd() % (sizeof(syms) / sizeof(syms[0]))]);
+  }else{
+    int q = k == 7;
+    buf[(*len)++] = q ? '{' : '(';
+    if(!q) *len += snprintf(buf + *len, cap - *len, "%s ", syms[rnd() % (sizeof(syms) / sizeof(syms[0]))]);
+    int n = (int)(rnd() % 5);
+    for(int i = 0; i < n; i++) gen_expr(buf, len, cap, depth+1);
+    buf[(*len)++] = q ? '}' : ')';
+    buf[(*len)++] = ' ';
+  }
+  buf[*len] = '\0';
+}
+
+// one line of input, about one in twenty is broken so errors get formatted too
+static char** gen(int n){
+  char** xs = malloc(sizeof(char*) * n);
+  for(int i = 0; i < n; i++){
+    char buf[4096];
+    size_t len = 0;
+    buf[0] = '\0';
+    gen_expr(buf, &len, sizeof(buf) - 8, 0);
+    if(rnd() % 20 == 0) buf[rnd() % (len + 1)] = "@)}x"[rnd() % 4];
+    xs[i] = malloc(strlen(buf)+1);
+    strcpy(xs[i], buf);
+  }
+  return xs;
+}
+
+static uint64_t fnv(uint64_t h, const char* s){
+  for(; *s; s++){
+    h ^= (unsigned char)*s;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static uint64_t ast_hash(uint64_t h, mpc_ast_t* a){
+  h = fnv(h, a->tag);
+  h = fnv(h, "\1");
+  h = fnv(h, a->contents);
+  h = fnv(h, "\2");
+  for(int i = 0; i < a->children_num; i++) h = ast_hash(h, a->children[i]);
+  return fnv(h, "\3");
+}
+
+// everything a parse produced, tree or error message, as one number
+static uint64_t parse_hash(mpc_parser_t* p, const char* s){
+  mpc_result_t r;
+  uint64_t h = 14695981039346656037ULL;
+  if(mpc_parse("<bench>", s, p, &r)){
+    h = ast_hash(h, r.output);
+    mpc_ast_delete(r.output);
+  }else{
+    char* e = mpc_err_string(r.error);
+    h = fnv(fnv(h, "error"), e);
+    free(e);
+    mpc_err_delete(r.error);
+  }
+  return h;
+}
+
+typedef struct {
+  mpc_parser_t* p;
+  char** xs;
+  uint64_t* want;
+  int n;
+  int start;
+  long bad;
+} job;
+
+// every thread parses the whole corpus, starting at a different place
+static void* run(void* arg){
+  job* j = arg;
+  for(int k = 0; k < j->n; k++){
+    int i = (j->start + k) % j->n;
+    if(parse_hash(j->p, j->xs[i]) != j->want[i]) j->bad++;
+  }
+  return NULL;
+}
+
+int main(int argc, char** argv){
+  int threads = argc > 1 ? atoi(argv[1]) : 8;
+  int n = argc > 2 ? atoi(argv[2]) : 20000;
+  if(threads < 1) threads = 1;
+
+  mpc_parser_t* Num = mpc_new("num");
+  mpc_parser_t* Sym = mpc_new("sym");
+  mpc_parser_t* Sexpr = mpc_new("sexpr");
+  mpc_parser_t* Qexpr = mpc_new("qexpr");
+  mpc_parser_t* Expr = mpc_new("expr");
+  mpc_parser_t* Crno = mpc_new("crno");
+  // the grammar main builds, sym generated from the builtin registry
+  lval_err_init();
+  builtin_init();
+  char* lang = builtin_grammar(crno_lang);
+  mpc_err_t* err = mpca_lang(MPCA_LANG_DEFAULT, lang, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  free(lang);
+  if(err){
+    mpc_err_print(err);
+    return 1;
+  }
+
+  char** xs = gen(n);
+  uint64_t* want = malloc(sizeof(uint64_t) * n);
+  double t0 = now();
+  for(int i = 0; i < n; i++) want[i] = parse_hash(Crno, xs[i]);
+  double base = n / (now() - t0);
+
+  printf("%-8s %14s %8s %10s\n", "threads", "parses/s", "speedup", "mismatch");
+  printf("%-8d %14.0f %7.2fx %10d\n", 1, base, 1.0, 0);
+
+  // powers of two up to the thread count, then the count itself
+  int counts[32], nc = 0;
+  for(int t = 2; t < threads && nc < 31; t *= 2) counts[nc++] = t;
+  if(threads > 1) counts[nc++] = threads;
+
+  int status = 0;
+  for(int c = 0; c < nc; c++){
+    int t = counts[c];
+    pthread_t* tids = malloc(sizeof(pthread_t) * t);
+    job* jobs = malloc(sizeof(job) * t);
+
+    double t1 = now();
+    for(int k = 0; k < t; k++){
+      jobs[k] = (job){ Crno, xs, want, n, (int)((long)n * k / t), 0 };
+      pthread_create(&tids[k], NULL, run, &jobs[k]);
+    }
+    long bad = 0;
+    for(int k = 0; k < t; k++){
+      pthread_join(tids[k], NULL);
+      bad += jobs[k].bad;
+    }
+    double rate = (double)n * t / (now() - t1);
+
+    printf("%-8d %14.0f %7.2fx %10ld\n", t, rate, rate / base, bad);
+    if(bad) status = 1;
+    free(tids);
+    free(jobs);
+  }
+
+  for(int i = 0; i < n; i++) free(xs[i]);
+  free(xs);
+  free(want);
+  mpc_cleanup(6, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  return status;
+}
@@ -0,0 +1,76 @@
+// strtod vs fmt_strtod on number-heavy input, checks every result is bit identical
+// gcc -std=c99 -O2 -Isrc -o bin/numparse bench/numparse.c src/fmt.c -lm && ./bin/numparse [n]
+
+#define _POSIX_C_SOURCE 199309L
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fmt.h"
+
+static unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long rnd(void){
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+static double now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// tokens matching the num rule, one per string, all in one block
+static char** gen(int n, int kind){
+  char** xs = malloc(sizeof(char*) * n);
+  for(int i = 0; i < n; i++){
+    char buf[64];
+    switch(kind){
+      case 0: snprintf(buf, sizeof(buf), "%d.%02d", (int)(rnd() % 100000), (int)(rnd() % 100)); break;
+      case 1: snprintf(buf, sizeof(buf), "%.17f", (double)(rnd() % 1000000) / 7.0); break;
+      case 2: snprintf(buf, sizeof(buf), "0.%015llu", rnd() % 1000000000000000ULL); break;
+      default: snprintf(buf, sizeof(buf), "%llu%llu.5", rnd(), rnd()); break;
+    }
+    xs[i] = malloc(strlen(buf)+1);
+    strcpy(xs[i], buf);
+  }
+  return xs;
+}
+
+int main(int argc, char** argv){
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  const char* kinds[] = { "short", "17 digits", "small", "over 19 digits" };
+
+  printf("%-16s %12s %12s %8s\n", "input", "strtod ns", "fmt ns", "speedup");
+  for(int k = 0; k < 4; k++){
+    char** xs = gen(n, k);
+    double* a = malloc(sizeof(double) * n);
+    double* b = malloc(sizeof(double) * n);
+
+    double t0 = now();
+    for(int i = 0; i < n; i++) a[i] = strtod(xs[i], NULL);
+    double t1 = now();
+    for(int i = 0; i < n; i++) b[i] = fmt_strtod(xs[i], NULL);
+    double t2 = now();
+
+    for(int i = 0; i < n; i++){
+      if(memcmp(&a[i], &b[i], sizeof(double)) != 0){
+        printf("mismatch on %s: %.17g vs %.17g\n", xs[i], a[i], b[i]);
+        return 1;
+      }
+    }
+
+    double ns1 = (t1 - t0) * 1e9 / n, ns2 = (t2 - t1) * 1e9 / n;
+    printf("%-16s %12.1f %12.1f %7.2fx\n", kinds[k], ns1, ns2, ns1 / ns2);
+
+    for(int i = 0; i < n; i++) free(xs[i]);
+    free(xs);
+    free(a);
+    free(b);
+  }
+  return 0;
+}
@@ -0,0 +1,271 @@
+// times parse, read, eval and print on their own over synthetic corpora and writes
+// one CSV row per corpus and stage with ns/op, allocations/op and peak RSS so far.
+// allocations are counted twice: every malloc in the process, and the mem.h hooks
+// split by kind along with pool hits and the peak of live bytes per kind added up.
+// every corpus runs in its own process so the RSS and peak columns are that corpus alone.
+// corpora are bench/gen.h settings, the four presets by default. --sweep reruns each
+// one with a setting at every value given, for plotting a stage against nodes_per_op
+// make bench, or gcc -std=c99 -O2 -pthread -Isrc -o bin/stages bench/stages.c bench/gen.c src/mpc.c src/fmt.c src/simd.c src/pool.c src/mem.c -lm
+// ./bin/stages [forms] [reps] [--corpus settings]... [--sweep key=v1,v2,...]
+// e.g. ./bin/stages 200 1 --corpus qexpr --sweep depth=4,6,8,10,12
+
+#define CRNO_NO_MAIN
+#include "parsing.c"
+#include "gen.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// every malloc, calloc and realloc in the process, glibc lets them be wrapped
+// here without touching the interpreter. elsewhere allocs/op reads -1
+static long allocs = 0;
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t n);
+extern void* __libc_calloc(size_t n, size_t m);
+extern void* __libc_realloc(void* p, size_t n);
+extern void __libc_free(void* p);
+void* malloc(size_t n){ allocs++; return __libc_malloc(n); }
+void* calloc(size_t n, size_t m){ allocs++; return __libc_calloc(n, m); }
+void* realloc(void* p, size_t n){ allocs++; return __libc_realloc(p, n); }
+void free(void* p){ __libc_free(p); }
+#define ALLOCS_COUNTED 1
+#else
+#define ALLOCS_COUNTED 0
+#endif
+
+static double now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// peak resident set in KB, linux reports ru_maxrss in KB already
+static long peak_rss(void){
+  struct rusage u;
+  getrusage(RUSAGE_SELF, &u);
+  return u.ru_maxrss;
+}
+
+static long ast_nodes(mpc_ast_t* t){
+  long n = 1;
+  for(int i = 0; i < t->children_num; i++) n += ast_nodes(t->children[i]);
+  return n;
+}
+
+static char** gen(const char* spec, int n){
+  gen_params g;
+  gen_defaults(&g);
+  gen_set(&g, spec);
+  char** xs = malloc(sizeof(char*) * n);
+  for(int i = 0; i < n; i++){
+    fmt_buf b = { NULL, 0, 0 };
+    gen_form(&g, &b);
+    fmt_putc(&b, '\0');
+    xs[i] = b.data;
+  }
+  return xs;
+}
+
+typedef struct {
+  double ns;
+  long allocs;
+  long kinds[MEM_KINDS]; // mem.h allocs of each kind
+  long hits;
+} stage;
+
+// counters at the start of a stage, read before the clock starts
+static stage stage_begin(void){
+  stage s = { 0, allocs, { 0 }, 0 };
+  for(int k = 0; k < MEM_KINDS; k++){
+    mem_stats m = mem_get(k);
+    s.kinds[k] = m.allocs;
+    s.hits += m.hits;
+  }
+  s.ns = now();
+  return s;
+}
+
+// what the stage since s cost, kept in best if it's the fastest rep
+static void stage_end(stage* best, stage s){
+  s.ns = now() - s.ns;
+  s.allocs = allocs - s.allocs;
+  long hits = 0;
+  for(int k = 0; k < MEM_KINDS; k++){
+    mem_stats m = mem_get(k);
+    s.kinds[k] = m.allocs - s.kinds[k];
+    hits += m.hits;
+  }
+  s.hits = hits - s.hits;
+  if(s.ns < best->ns) *best = s;
+}
+
+// the peaks of live bytes of every kind added up, in KB
+static long peak_live(void){
+  long n = 0;
+  for(int k = 0; k < MEM_KINDS; k++) n += mem_get(k).peak;
+  return n / 1024;
+}
+
+enum { PARSE, READ, EVAL, PRINT, STAGES };
+static const char* stage_names[STAGES] = { "parse", "read", "eval", "print" };
+
+// the whole pipeline over the corpus reps times, a stage's time is its best rep
+static void run(mpc_parser_t* p, const char* corpus, int n, int reps){
+  char** xs = gen(corpus, n);
+  mpc_ast_t** asts = malloc(sizeof(mpc_ast_t*) * n);
+  lval** vs = malloc(sizeof(lval*) * n);
+  fmt_buf out = { NULL, 0, 0 };
+  stage st[STAGES];
+  long rss[STAGES], live[STAGES];
+  long nodes = 0;
+  for(int s = 0; s < STAGES; s++) st[s] = (stage){ 1e300, 0, { 0 }, 0 };
+
+  for(int r = 0; r < reps; r++){
+    stage b = stage_begin();
+    for(int i = 0; i < n; i++){
+      mpc_result_t res;
+      if(mpc_parse("<bench>", xs[i], p, &res)) asts[i] = res.output;
+      else{
+        mpc_err_delete(res.error);
+        asts[i] = NULL;
+      }
+    }
+    stage_end(&st[PARSE], b);
+    rss[PARSE] = peak_rss();
+    live[PARSE] = peak_live();
+    if(r == 0) for(int i = 0; i < n; i++) nodes += asts[i] ? ast_nodes(asts[i]) : 0;
+
+    b = stage_begin();
+    for(int i = 0; i < n; i++) vs[i] = asts[i] ? lval_read(asts[i]) : lval_sexpr();
+    stage_end(&st[READ], b);
+    rss[READ] = peak_rss();
+    live[READ] = peak_live();
+
+    b = stage_begin();
+    for(int i = 0; i < n; i++) vs[i] = lval_eval(vs[i]);
+    stage_end(&st[EVAL], b);
+    rss[EVAL] = peak_rss();
+    live[EVAL] = peak_live();
+
+    b = stage_begin();
+    for(int i = 0; i < n; i++){
+      out.len = 0;
+      lval_write(&out, vs[i]);
+    }
+    stage_end(&st[PRINT], b);
+    rss[PRINT] = peak_rss();
+    live[PRINT] = peak_live();
+
+    for(int i = 0; i < n; i++){
+      lval_del(vs[i]);
+      if(asts[i]) mpc_ast_delete(asts[i]);
+    }
+  }
+
+  for(int s = 0; s < STAGES; s++){
+    printf("\"%s\",%.1f,%s,%d,%.1f,", corpus, (double)nodes / n, stage_names[s], n, st[s].ns * 1e9 / n);
+    if(ALLOCS_COUNTED) printf("%.2f,", (double)st[s].allocs / n);
+    else printf("-1,");
+    for(int k = 0; k < MEM_KINDS; k++) printf("%.2f,", (double)st[s].kinds[k] / n);
+    printf("%.2f,%ld,%ld\n", (double)st[s].hits / n, live[s], rss[s]);
+  }
+
+  for(int i = 0; i < n; i++) free(xs[i]);
+  free(xs);
+  free(asts);
+  free(vs);
+  fmt_free(&out);
+}
+
+int main(int argc, char** argv){
+  int n = 1000, reps = 3, pos = 0, ncorpora = 0;
+  const char** corpora = malloc(sizeof(char*) * (argc + 4));
+  char* sweep = NULL;
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "--corpus") == 0 && i+1 < argc) corpora[ncorpora++] = argv[++i];
+    else if(strcmp(argv[i], "--sweep") == 0 && i+1 < argc) sweep = argv[++i];
+    else if(pos++ == 0) n = atoi(argv[i]);
+    else reps = atoi(argv[i]);
+  }
+  if(n < 1) n = 1;
+  if(reps < 1) reps = 1;
+  if(!ncorpora){
+    const char* presets[] = { "wide", "deep", "qexpr", "numbers" };
+    for(int c = 0; c < 4; c++) corpora[ncorpora++] = presets[c];
+  }
+
+  // every corpus once per swept value, with the value appended so it wins
+  char** specs = malloc(sizeof(char*) * ncorpora * (sweep ? strlen(sweep) + 1 : 1));
+  int nspecs = 0;
+  for(int c = 0; c < ncorpora; c++){
+    gen_params g;
+    gen_defaults(&g);
+    if(!gen_set(&g, corpora[c])){
+      fprintf(stderr, "stages: bad settings %s\n", corpora[c]);
+      return 2;
+    }
+    if(!sweep){
+      specs[nspecs++] = strdup(corpora[c]);
+      continue;
+    }
+    char* eq = strchr(sweep, '=');
+    if(!eq){
+      fprintf(stderr, "stages: --sweep wants key=v1,v2,...\n");
+      return 2;
+    }
+    for(char* v = eq+1; *v; ){
+      size_t len = strcspn(v, ",");
+      size_t size = strlen(corpora[c]) + (eq - sweep) + len + 3;
+      char* spec = malloc(size);
+      snprintf(spec, size, "%s,%.*s=%.*s", corpora[c], (int)(eq - sweep), sweep, (int)len, v);
+      if(!gen_set(&g, spec)){
+        fprintf(stderr, "stages: bad settings %s\n", spec);
+        return 2;
+      }
+      specs[nspecs++] = spec;
+      v += len + (v[len] == ',');
+    }
+  }
+
+  // every rep after the first would be answered by the memo cache
+  cache_on = 0;
+  // the per kind columns, the same as --mem-stats
+  mem_on = 1;
+
+  mpc_parser_t* Num = mpc_new("num");
+  mpc_parser_t* Sym = mpc_new("sym");
+  mpc_parser_t* Sexpr = mpc_new("sexpr");
+  mpc_parser_t* Qexpr = mpc_new("qexpr");
+  mpc_parser_t* Expr = mpc_new("expr");
+  mpc_parser_t* Crno = mpc_new("crno");
+  lval_err_init();
+  builtin_init();
+  char* lang = builtin_grammar(crno_lang);
+  mpca_lang(MPCA_LANG_DEFAULT, lang, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  free(lang);
+
+  printf("corpus,nodes_per_op,stage,ops,ns_per_op,allocs_per_op,");
+  for(int k = 0; k < MEM_KINDS; k++) printf("%s_allocs_per_op,", mem_kind_names[k]);
+  printf("hits_per_op,peak_live_kb,peak_rss_kb\n");
+  fflush(stdout);
+  int status = 0;
+  for(int c = 0; c < nspecs; c++){
+    pid_t pid = fork();
+    if(pid == 0){
+      run(Crno, specs[c], n, reps);
+      fflush(stdout);
+      _exit(0);
+    }
+    int ws = 0;
+    if(pid < 0 || waitpid(pid, &ws, 0) < 0 || !WIFEXITED(ws) || WEXITSTATUS(ws) != 0){
+      fprintf(stderr, "stages: %s failed\n", specs[c]);
+      status = 1;
+    }
+  }
+
+  for(int c = 0; c < nspecs; c++) free(specs[c]);
+  free(specs);
+  free(corpora);
+  mpc_cleanup(6, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  return status;
+}
@@ -0,0 +1,36 @@
+#ifndef fmt_h
+#define fmt_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// growable output buffer, handed to the fd with as few write() calls as possible
+typedef struct {
+  char* data;
+  size_t len;
+  size_t cap;
+} fmt_buf;
+
+// doubles as "%lf" with 6 fixed decimals instead of the shortest round trip (--fixed-fp),
+// parsing.c prints ints through fmt_double too when it's set
+extern int fmt_fixed;
+
+// makes room for n more bytes
+void fmt_reserve(fmt_buf* b, size_t n);
+
+void fmt_putc(fmt_buf* b, char c);
+void fmt_puts(fmt_buf* b, const char* s);
+void fmt_int(fmt_buf* b, int64_t x);
+void fmt_double(fmt_buf* b, double x);
+
+// shortest digits that read back as exactly x, into out (32 bytes is enough), returns the length
+int fmt_dtoa(char* out, double x);
+
+// drop-in strtod, exact and locale independent for plain decimals, anything else goes to strtod
+double fmt_strtod(const char* s, char** end);
+
+// writes out everything buffered and empties b, -1 if the fd fails
+int fmt_flush(fmt_buf* b, int fd);
+void fmt_free(fmt_buf* b);
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include "mem.h"
+#include "pool.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+const char* mem_kind_names[MEM_KINDS] = { "lval", "ast", "parse", "err" };
+
+// ----- allocator ----- //
+
+static void* mem_libc_alloc(void* ctx, size_t n){ (void)ctx; return malloc(n); }
+static void* mem_libc_realloc(void* ctx, void* p, size_t old, size_t n){ (void)ctx; (void)old; return realloc(p, n); }
+static void mem_libc_free(void* ctx, void* p, size_t n){ (void)ctx; (void)n; free(p); }
+
+static const mem_allocator mem_libc = { mem_libc_alloc, mem_libc_realloc, mem_libc_free, NULL };
+static const mem_allocator* mem_with = &mem_libc;
+
+void mem_use(const mem_allocator* a){
+  mem_with = a ? a : &mem_libc;
+}
+
+size_t mem_block(void* p){
+  if(!p) return 0;
+#if defined(__GLIBC__)
+  return malloc_usable_size(p);
+#elif defined(_WIN32)
+  return _msize(p);
+#else
+  return 0;
+#endif
+}
+
+// ----- counters ----- //
+
+int mem_on = 0;
+
+enum { MEM_ALLOCS, MEM_FREES, MEM_BYTES, MEM_HITS, MEM_LIVE, MEM_PEAK, MEM_COUNTERS };
+
+// every thread counts into its own block, only it writes to it so there are no
+// locked adds on the way. blocks outlive their threads so mem_get still sees them
+typedef struct mem_local {
+  long n[MEM_KINDS][MEM_COUNTERS];
+  struct mem_local* next;
+} mem_local;
+
+static mem_local* mem_threads = NULL;
+static POOL_LOCAL mem_local* mem_mine = NULL;
+
+static mem_local* mem_self(void){
+  if(mem_mine) return mem_mine;
+  mem_local* m = calloc(1, sizeof(mem_local));
+  m->next = __atomic_load_n(&mem_threads, __ATOMIC_RELAXED);
+  while(!__atomic_compare_exchange_n(&mem_threads, &m->next, m, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  return mem_mine = m;
+}
+
+// only the owner writes, readers on other threads load relaxed
+static void mem_bump(long* c, long n){
+  __atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+void mem_count(int kind, long allocs, long frees, long bytes, long live){
+  if(!mem_on) return;
+  long* c = mem_self()->n[kind];
+  if(allocs) mem_bump(&c[MEM_ALLOCS], allocs);
+  if(frees) mem_bump(&c[MEM_FREES], frees);
+  if(bytes) mem_bump(&c[MEM_BYTES], bytes);
+  if(!live) return;
+
+  mem_bump(&c[MEM_LIVE], live);
+  if(c[MEM_LIVE] > c[MEM_PEAK]) __atomic_store_n(&c[MEM_PEAK], c[MEM_LIVE], __ATOMIC_RELAXED);
+}
+
+void mem_hit(int kind){
+  if(mem_on) mem_bump(&mem_self()->n[kind][MEM_HITS], 1);
+}
+
+mem_stats mem_get(int kind){
+  mem_stats s = { 0, 0, 0, 0, 0, 0 };
+  for(mem_local* m = __atomic_load_n(&mem_threads, __ATOMIC_ACQUIRE); m; m = m->next){
+    s.allocs += __atomic_load_n(&m->n[kind][MEM_ALLOCS], __ATOMIC_RELAXED);
+    s.frees += __atomic_load_n(&m->n[kind][MEM_FREES], __ATOMIC_RELAXED);
+    s.bytes += __atomic_load_n(&m->n[kind][MEM_BYTES], __ATOMIC_RELAXED);
+    s.hits += __atomic_load_n(&m->n[kind][MEM_HITS], __ATOMIC_RELAXED);
+    s.live += __atomic_load_n(&m->n[kind][MEM_LIVE], __ATOMIC_RELAXED);
+    s.peak += __atomic_load_n(&m->n[kind][MEM_PEAK], __ATOMIC_RELAXED);
+  }
+  return s;
+}
+
+// ----- counted allocations ----- //
+
+void* mem_alloc(int kind, size_t n){
+  if(mem_on) mem_count(kind, 1, 0, n, n);
+  return mem_with->alloc(mem_with->ctx, n);
+}
+
+void* mem_calloc(int kind, size_t n, size_t m){
+  void* p = mem_alloc(kind, n * m);
+  if(p) memset(p, 0, n * m);
+  return p;
+}
+
+void* mem_realloc(int kind, void* p, size_t old, size_t n){
+  if(!p) return mem_alloc(kind, n);
+  if(!n){
+    mem_free(kind, p, old);
+    return NULL;
+  }
+  if(mem_on) mem_count(kind, 1, 0, n, (long)n - (long)old);
+  return mem_with->realloc(mem_with->ctx, p, old, n);
+}
+
+void mem_free(int kind, void* p, size_t n){
+  if(!p) return;
+  if(mem_on) mem_count(kind, 0, 1, 0, -(long)n);
+  mem_with->free(mem_with->ctx, p, n);
+}
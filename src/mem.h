@@ -0,0 +1,60 @@
+#ifndef mem_h
+#define mem_h
+
+#include <stddef.h>
+
+// allocation hooks shared by the interpreter and mpc, every allocation is counted
+// under what it's for so the cost of a line can be read back with (mem-stats)
+
+enum mem_kinds { MEM_LVAL, MEM_AST, MEM_PARSE, MEM_ERR, MEM_KINDS };
+
+// "lval", "ast", "parse" and "err"
+extern const char* mem_kind_names[MEM_KINDS];
+
+// where memory with a known size goes, malloc by default. realloc and free are
+// given the size the block was asked for, realloc never sees NULL or 0
+typedef struct mem_allocator {
+  void* (*alloc)(void* ctx, size_t n);
+  void* (*realloc)(void* ctx, void* p, size_t old, size_t n);
+  void (*free)(void* ctx, void* p, size_t n);
+  void* ctx;
+} mem_allocator;
+
+// NULL for malloc. only before anything has been allocated through it
+void mem_use(const mem_allocator* a);
+
+// through the allocator, and counted. realloc of NULL allocates, to 0 frees
+void* mem_alloc(int kind, size_t n);
+void* mem_calloc(int kind, size_t n, size_t m);
+void* mem_realloc(int kind, void* p, size_t old, size_t n);
+void mem_free(int kind, void* p, size_t n);
+
+// allocations are only counted while this is set, --mem-stats sets it before
+// anything is allocated. off, a hook costs a load and a branch on the way to malloc
+extern int mem_on;
+
+// counts memory that stays on malloc because its size isn't known when it's freed,
+// or it can be freed by code that doesn't know about kinds. allocs and frees are
+// calls made, bytes what they asked for and live the change in bytes held
+void mem_count(int kind, long allocs, long frees, long bytes, long live);
+
+// an allocation a pool of its own served without asking for memory
+void mem_hit(int kind);
+
+// bytes malloc reserved for p, 0 for NULL or where libc can't tell
+size_t mem_block(void* p);
+
+typedef struct mem_stats {
+  long allocs;
+  long frees;
+  long bytes;
+  long hits;
+  long live;
+  long peak;  // most each thread held at once, added up, so never below the true peak
+} mem_stats;
+
+// totals over every thread so far. a thread that frees what another allocated
+// counts it as negative live, the totals still add up
+mem_stats mem_get(int kind);
+
+#endif
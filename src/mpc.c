@@ -1,4 +1,5 @@
 #include "mpc.h"
+#include "mem.h"
 
 /*
 ** State Type
@@ -102,7 +103,7 @@ typedef struct {
 
 static mpc_input_t *mpc_input_new_string(const char *filename, const char *string) {
 
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
+  mpc_input_t *i = mem_alloc(MEM_PARSE, sizeof(mpc_input_t));
 
   i->filename = malloc(strlen(filename) + 1);
   strcpy(i->filename, filename);
@@ -131,7 +132,7 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
 
 static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *string, size_t length) {
 
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
+  mpc_input_t *i = mem_alloc(MEM_PARSE, sizeof(mpc_input_t));
 
   i->filename = malloc(strlen(filename) + 1);
   strcpy(i->filename, filename);
@@ -162,7 +163,7 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
 
 static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
 
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
+  mpc_input_t *i = mem_alloc(MEM_PARSE, sizeof(mpc_input_t));
 
   i->filename = malloc(strlen(filename) + 1);
   strcpy(i->filename, filename);
@@ -191,7 +192,7 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
 
 static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
 
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
+  mpc_input_t *i = mem_alloc(MEM_PARSE, sizeof(mpc_input_t));
 
   i->filename = malloc(strlen(filename) + 1);
   strcpy(i->filename, filename);
@@ -225,7 +226,7 @@ static void mpc_input_delete(mpc_input_t *i) {
 
   free(i->marks);
   free(i->lasts);
-  free(i);
+  mem_free(MEM_PARSE, i, sizeof(mpc_input_t));
 }
 
 static int mpc_mem_ptr(mpc_input_t *i, void *p) {
@@ -234,11 +235,31 @@ static int mpc_mem_ptr(mpc_input_t *i, void *p) {
     (char*)p <  (char*)(i->mem) + (MPC_INPUT_MEM_NUM * sizeof(mpc_mem_t));
 }
 
+/*
+** Temporaries that miss the pool go to malloc. They can leave through
+** mpc_export and be freed by anyone, so they're counted but never live.
+*/
+
+static void *mpc_heap_malloc(size_t n) {
+  mem_count(MEM_PARSE, 1, 0, n, 0);
+  return malloc(n);
+}
+
+static void *mpc_heap_realloc(void *p, size_t n) {
+  mem_count(MEM_PARSE, 1, 0, n, 0);
+  return realloc(p, n);
+}
+
+static void mpc_heap_free(void *p) {
+  if (p) { mem_count(MEM_PARSE, 0, 1, 0, 0); }
+  free(p);
+}
+
 static void *mpc_malloc(mpc_input_t *i, size_t n) {
   size_t j;
   char *p;
 
-  if (n > sizeof(mpc_mem_t)) { return malloc(n); }
+  if (n > sizeof(mpc_mem_t)) { return mpc_heap_malloc(n); }
 
   j = i->mem_index;
   do {
@@ -246,12 +267,13 @@ static void *mpc_malloc(mpc_input_t *i, size_t n) {
       p = (void*)(i->mem + i->mem_index);
       i->mem_full[i->mem_index] = 1;
       i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
+      mem_hit(MEM_PARSE);
       return p;
     }
     i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
   } while (j != i->mem_index);
 
-  return malloc(n);
+  return mpc_heap_malloc(n);
 }
 
 static void *mpc_calloc(mpc_input_t *i, size_t n, size_t m) {
@@ -262,7 +284,7 @@ static void *mpc_calloc(mpc_input_t *i, size_t n, size_t m) {
 
 static void mpc_free(mpc_input_t *i, void *p) {
   size_t j;
-  if (!mpc_mem_ptr(i, p)) { free(p); return; }
+  if (!mpc_mem_ptr(i, p)) { mpc_heap_free(p); return; }
   j = ((size_t)(((char*)p) - ((char*)i->mem))) / sizeof(mpc_mem_t);
   i->mem_full[j] = 0;
 }
@@ -271,10 +293,10 @@ static void *mpc_realloc(mpc_input_t *i, void *p, size_t n) {
 
   char *q = NULL;
 
-  if (!mpc_mem_ptr(i, p)) { return realloc(p, n); }
+  if (!mpc_mem_ptr(i, p)) { return mpc_heap_realloc(p, n); }
 
   if (n > sizeof(mpc_mem_t)) {
-    q = malloc(n);
+    q = mpc_heap_malloc(n);
     memcpy(q, p, sizeof(mpc_mem_t));
     mpc_free(i, p);
     return q;
@@ -286,7 +308,7 @@ static void *mpc_realloc(mpc_input_t *i, void *p, size_t n) {
 static void *mpc_export(mpc_input_t *i, void *p) {
   char *q = NULL;
   if (!mpc_mem_ptr(i, p)) { return p; }
-  q = malloc(sizeof(mpc_mem_t));
+  q = mpc_heap_malloc(sizeof(mpc_mem_t));
   memcpy(q, p, sizeof(mpc_mem_t));
   mpc_free(i, p);
   return q;
@@ -568,8 +590,26 @@ static mpc_state_t *mpc_input_state_copy(mpc_input_t *i) {
 ** Error Type
 */
 
+/*
+** Errors handed to the caller are counted whole, in what malloc reserved
+*/
+
+static long mpc_err_bytes(mpc_err_t *x) {
+  int i;
+  long n = mem_block(x) + mem_block(x->expected) + mem_block(x->filename) + mem_block(x->failure);
+  for (i = 0; i < x->expected_num; i++) { n += mem_block(x->expected[i]); }
+  return n;
+}
+
+static mpc_err_t *mpc_err_counted(mpc_err_t *x) {
+  long n = mpc_err_bytes(x);
+  mem_count(MEM_ERR, 1, 0, n, n);
+  return x;
+}
+
 void mpc_err_delete(mpc_err_t *x) {
   int i;
+  mem_count(MEM_ERR, 0, 1, 0, -mpc_err_bytes(x));
   for (i = 0; i < x->expected_num; i++) { free(x->expected[i]); }
   free(x->expected);
   free(x->filename);
@@ -597,14 +637,13 @@ static void mpc_err_string_cat(char *buffer, int *pos, int *max, char const *fmt
   va_end(va);
 }
 
-static char char_unescape_buffer[4];
+/* buf holds at least 4 chars, caller owned so concurrent parses don't share it */
+static const char *mpc_err_char_unescape(char c, char *buf) {
 
-static const char *mpc_err_char_unescape(char c) {
-
-  char_unescape_buffer[0] = '\'';
-  char_unescape_buffer[1] = ' ';
-  char_unescape_buffer[2] = '\'';
-  char_unescape_buffer[3] = '\0';
+  buf[0] = '\'';
+  buf[1] = ' ';
+  buf[2] = '\'';
+  buf[3] = '\0';
 
   switch (c) {
     case '\a': return "bell";
@@ -617,8 +656,8 @@ static const char *mpc_err_char_unescape(char c) {
     case '\t': return "tab";
     case ' ' : return "space";
     default:
-      char_unescape_buffer[1] = c;
-      return char_unescape_buffer;
+      buf[1] = c;
+      return buf;
   }
 
 }
@@ -629,6 +668,7 @@ char *mpc_err_string(mpc_err_t *x) {
   int pos = 0;
   int max = 1023;
   char *buffer = calloc(1, 1024);
+  char unescaped[4];
 
   if (x->failure) {
     mpc_err_string_cat(buffer, &pos, &max,
@@ -653,7 +693,7 @@ char *mpc_err_string(mpc_err_t *x) {
   }
 
   mpc_err_string_cat(buffer, &pos, &max, " at ");
-  mpc_err_string_cat(buffer, &pos, &max, mpc_err_char_unescape(x->recieved));
+  mpc_err_string_cat(buffer, &pos, &max, "%s", mpc_err_char_unescape(x->recieved, unescaped));
   mpc_err_string_cat(buffer, &pos, &max, "\n");
 
   return realloc(buffer, strlen(buffer) + 1);
@@ -701,7 +741,7 @@ static mpc_err_t *mpc_err_file(const char *filename, const char *failure) {
   x->failure = malloc(strlen(failure) + 1);
   strcpy(x->failure, failure);
   x->recieved = ' ';
-  return x;
+  return mpc_err_counted(x);
 }
 
 static void mpc_err_delete_internal(mpc_input_t *i, mpc_err_t *x) {
@@ -714,15 +754,19 @@ static void mpc_err_delete_internal(mpc_input_t *i, mpc_err_t *x) {
   mpc_free(i, x);
 }
 
+/* Defined with the trie below, swaps trie marks for their literals */
+static void mpc_err_expand(mpc_input_t *i, mpc_err_t *x);
+
 static mpc_err_t *mpc_err_export(mpc_input_t *i, mpc_err_t *x) {
   int j;
+  mpc_err_expand(i, x);
   for (j = 0; j < x->expected_num; j++) {
     x->expected[j] = mpc_export(i, x->expected[j]);
   }
   x->expected = mpc_export(i, x->expected);
   x->filename = mpc_export(i, x->filename);
   x->failure = mpc_export(i, x->failure);
-  return mpc_export(i, x);
+  return mpc_err_counted(mpc_export(i, x));
 }
 
 static int mpc_err_contains_expected(mpc_input_t *i, mpc_err_t *x, char *expected) {
@@ -802,6 +846,8 @@ static mpc_err_t *mpc_err_repeat(mpc_input_t *i, mpc_err_t *x, const char *prefi
 
   if (x == NULL) { return NULL; }
 
+  mpc_err_expand(i, x);
+
   if (x->expected_num == 0) {
     expect = mpc_calloc(i, 1, 1);
     x->expected_num = 1;
@@ -872,6 +918,224 @@ static mpc_err_t *mpc_err_merge(mpc_input_t *i, mpc_err_t *x, mpc_err_t *y) {
   return mpc_err_or(i, errs, 2);
 }
 
+/*
+** Trie Type
+*/
+
+/*
+** A trie holds a set of literal alternatives
+** (as produced by `'c'` and `"string"` in the
+** grammar) so that an `or` of many literals can
+** be matched in a single scan of the input with
+** longest-match semantics, rather than trying
+** each literal in turn and rewinding.
+**
+** Node `0` is the root. Its children are found
+** via a direct lookup table, deeper nodes keep
+** their children in a sibling list. An index of
+** zero is used to mean "no node".
+**
+** A failed match is tried and thrown away many
+** times in an ordinary parse, so its error holds
+** a single mark naming the trie. The mark is
+** swapped in place for the literals it stands
+** for only once the error is joined up by
+** `mpc_err_repeat` or handed to the caller.
+*/
+
+#define MPC_TRIE_MARK '\001'
+
+typedef struct {
+  char c;
+  int child;
+  int sibling;
+  int leaf;
+} mpc_trie_node_t;
+
+typedef struct {
+  int tok;
+  int n;
+  char **xs;
+  char **es;
+  const char **tags;
+  int nodes_num;
+  mpc_trie_node_t *nodes;
+  int root[256];
+  char mark[32];
+} mpc_trie_t;
+
+static int mpc_trie_node_new(mpc_trie_t *t, char c) {
+  t->nodes_num++;
+  t->nodes = realloc(t->nodes, sizeof(mpc_trie_node_t) * t->nodes_num);
+  t->nodes[t->nodes_num-1].c = c;
+  t->nodes[t->nodes_num-1].child = 0;
+  t->nodes[t->nodes_num-1].sibling = 0;
+  t->nodes[t->nodes_num-1].leaf = -1;
+  return t->nodes_num-1;
+}
+
+static mpc_trie_t *mpc_trie_new(int tok) {
+  mpc_trie_t *t = calloc(1, sizeof(mpc_trie_t));
+  t->tok = tok;
+  sprintf(t->mark, "%c%p", MPC_TRIE_MARK, (void*)t);
+  mpc_trie_node_new(t, '\0');
+  return t;
+}
+
+static int mpc_trie_child(const mpc_trie_t *t, int n, char c) {
+  int j;
+  if (n == 0) { return t->root[(unsigned char)c]; }
+  for (j = t->nodes[n].child; j != 0; j = t->nodes[j].sibling) {
+    if (t->nodes[j].c == c) { return j; }
+  }
+  return 0;
+}
+
+static void mpc_trie_insert(mpc_trie_t *t, const char *x, const char *e, const char *tag) {
+
+  int n = 0, m;
+  const char *y;
+
+  for (y = x; *y; y++) {
+    m = mpc_trie_child(t, n, *y);
+    if (m == 0) {
+      m = mpc_trie_node_new(t, *y);
+      if (n == 0) {
+        t->root[(unsigned char)*y] = m;
+      } else {
+        t->nodes[m].sibling = t->nodes[n].child;
+        t->nodes[n].child = m;
+      }
+    }
+    n = m;
+  }
+
+  /* Earlier alternatives win on duplicates */
+  if (t->nodes[n].leaf >= 0) { return; }
+
+  t->n++;
+  t->xs = realloc(t->xs, sizeof(char*) * t->n);
+  t->es = realloc(t->es, sizeof(char*) * t->n);
+  t->tags = realloc(t->tags, sizeof(char*) * t->n);
+  t->xs[t->n-1] = malloc(strlen(x) + 1);
+  t->es[t->n-1] = malloc(strlen(e) + 1);
+  strcpy(t->xs[t->n-1], x);
+  strcpy(t->es[t->n-1], e);
+  t->tags[t->n-1] = tag;
+  t->nodes[n].leaf = t->n-1;
+}
+
+static void mpc_trie_merge(mpc_trie_t *t, mpc_trie_t *u) {
+  int j;
+  for (j = 0; j < u->n; j++) {
+    mpc_trie_insert(t, u->xs[j], u->es[j], u->tags[j]);
+  }
+}
+
+static mpc_trie_t *mpc_trie_copy(mpc_trie_t *u) {
+  mpc_trie_t *t = mpc_trie_new(u->tok);
+  mpc_trie_merge(t, u);
+  return t;
+}
+
+static void mpc_trie_delete(mpc_trie_t *t) {
+  int j;
+  for (j = 0; j < t->n; j++) { free(t->xs[j]); free(t->es[j]); }
+  free(t->xs);
+  free(t->es);
+  free(t->tags);
+  free(t->nodes);
+  free(t);
+}
+
+static int mpc_input_trie(mpc_input_t *i, const mpc_trie_t *t, mpc_ast_t **o) {
+
+  mpc_state_t s = i->state;
+  int n = 0, best = t->nodes[0].leaf;
+  int depth = 0, best_depth = 0, j;
+  char x;
+
+  /* Outer mark is held while replaying the best match */
+  mpc_input_mark(i);
+  mpc_input_mark(i);
+
+  while (!mpc_input_terminated(i)) {
+    x = mpc_input_getc(i);
+    n = mpc_trie_child(t, n, x);
+    if (n == 0) { mpc_input_failure(i, x); break; }
+    mpc_input_success(i, x, NULL);
+    depth++;
+    if (t->nodes[n].leaf >= 0) {
+      best = t->nodes[n].leaf;
+      best_depth = depth;
+    }
+  }
+
+  if (best < 0) {
+    mpc_input_rewind(i);
+    mpc_input_unmark(i);
+    return 0;
+  }
+
+  if (depth != best_depth) {
+    mpc_input_rewind(i);
+    for (j = 0; j < best_depth; j++) {
+      mpc_input_success(i, mpc_input_getc(i), NULL);
+    }
+  } else {
+    mpc_input_unmark(i);
+  }
+  mpc_input_unmark(i);
+
+  *o = mpc_ast_new(t->tags[best], t->xs[best]);
+  (*o)->state = s;
+
+  if (t->tok) {
+    while (!mpc_input_terminated(i) && strchr(" \f\n\r\t\v", mpc_input_peekc(i))) {
+      mpc_input_success(i, mpc_input_getc(i), NULL);
+    }
+  }
+
+  return 1;
+}
+
+static mpc_err_t *mpc_err_trie(mpc_input_t *i, const mpc_trie_t *t) {
+  return mpc_err_new(i, t->mark);
+}
+
+static void mpc_err_expand(mpc_input_t *i, mpc_err_t *x) {
+
+  int j, k, n;
+  char **es;
+  void *p;
+  const mpc_trie_t *t;
+
+  for (j = 0; j < x->expected_num; j++) {
+    if (x->expected[j][0] == MPC_TRIE_MARK) { break; }
+  }
+  if (j == x->expected_num) { return; }
+
+  /* Rebuilt in order, the same as merging every literal one by one would give */
+  es = x->expected;
+  n = x->expected_num;
+  x->expected = NULL;
+  x->expected_num = 0;
+
+  for (j = 0; j < n; j++) {
+    if (es[j][0] != MPC_TRIE_MARK) {
+      if (!mpc_err_contains_expected(i, x, es[j])) { mpc_err_add_expected(i, x, es[j]); }
+    } else {
+      sscanf(es[j] + 1, "%p", &p);
+      t = p;
+      for (k = 0; k < t->n; k++) {
+        if (!mpc_err_contains_expected(i, x, t->es[k])) { mpc_err_add_expected(i, x, t->es[k]); }
+      }
+    }
+    mpc_free(i, es[j]);
+  }
+  mpc_free(i, es);
+}
+
 /*
 ** Parser Type
 */
@@ -910,7 +1174,9 @@ enum {
   MPC_TYPE_CHECK_WITH = 26,
 
   MPC_TYPE_SOI        = 27,
-  MPC_TYPE_EOI        = 28
+  MPC_TYPE_EOI        = 28,
+
+  MPC_TYPE_TRIE       = 29
 };
 
 typedef struct { char *m; } mpc_pdata_fail_t;
@@ -930,6 +1196,7 @@ typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; } mpc_pdata_not_
 typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_repeat_t;
 typedef struct { int n; mpc_parser_t **xs; } mpc_pdata_or_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t **xs; mpc_dtor_t *dxs;  } mpc_pdata_and_t;
+typedef struct { mpc_trie_t *t; } mpc_pdata_trie_t;
 
 typedef union {
   mpc_pdata_fail_t fail;
@@ -949,6 +1216,7 @@ typedef union {
   mpc_pdata_repeat_t repeat;
   mpc_pdata_and_t and;
   mpc_pdata_or_t or;
+  mpc_pdata_trie_t trie;
 } mpc_pdata_t;
 
 struct mpc_parser_t {
@@ -1038,7 +1306,7 @@ enum {
   if (x) { MPC_SUCCESS(r->output); } \
   else { MPC_FAILURE(NULL); }
 
-static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
+static int mpc_parse_run(mpc_input_t *i, const mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
 
   int j = 0, k = 0;
   mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
@@ -1060,6 +1328,13 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
     case MPC_TYPE_SOI:     MPC_PRIMITIVE(mpc_input_soi(i, (char**)&r->output));
     case MPC_TYPE_EOI:     MPC_PRIMITIVE(mpc_input_eoi(i, (char**)&r->output));
 
+    case MPC_TYPE_TRIE:
+      if (mpc_input_trie(i, p->data.trie.t, (mpc_ast_t**)&r->output)) {
+        MPC_SUCCESS(r->output);
+      } else {
+        MPC_FAILURE(mpc_err_trie(i, p->data.trie.t));
+      }
+
     /* Other parsers */
 
     case MPC_TYPE_UNDEFINED: MPC_FAILURE(mpc_err_fail(i, "Parser Undefined!"));
@@ -1291,7 +1566,7 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
 #undef MPC_FAILURE
 #undef MPC_PRIMITIVE
 
-int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+int mpc_parse_input(mpc_input_t *i, const mpc_parser_t *p, mpc_result_t *r) {
   int x;
   mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
   e->state = mpc_state_invalid();
@@ -1305,7 +1580,7 @@ int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
   return x;
 }
 
-int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r) {
+int mpc_parse(const char *filename, const char *string, const mpc_parser_t *p, mpc_result_t *r) {
   int x;
   mpc_input_t *i = mpc_input_new_string(filename, string);
   x = mpc_parse_input(i, p, r);
@@ -1313,7 +1588,7 @@ int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_res
   return x;
 }
 
-int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r) {
+int mpc_nparse(const char *filename, const char *string, size_t length, const mpc_parser_t *p, mpc_result_t *r) {
   int x;
   mpc_input_t *i = mpc_input_new_nstring(filename, string, length);
   x = mpc_parse_input(i, p, r);
@@ -1321,7 +1596,7 @@ int mpc_nparse(const char *filename, const char *string, size_t length, mpc_pars
   return x;
 }
 
-int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result_t *r) {
+int mpc_parse_file(const char *filename, FILE *file, const mpc_parser_t *p, mpc_result_t *r) {
   int x;
   mpc_input_t *i = mpc_input_new_file(filename, file);
   x = mpc_parse_input(i, p, r);
@@ -1329,7 +1604,7 @@ int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result
   return x;
 }
 
-int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r) {
+int mpc_parse_pipe(const char *filename, FILE *pipe, const mpc_parser_t *p, mpc_result_t *r) {
   int x;
   mpc_input_t *i = mpc_input_new_pipe(filename, pipe);
   x = mpc_parse_input(i, p, r);
@@ -1337,7 +1612,7 @@ int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result
   return x;
 }
 
-int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
+int mpc_parse_contents(const char *filename, const mpc_parser_t *p, mpc_result_t *r) {
 
   FILE *f = fopen(filename, "rb");
   int res;
@@ -1394,6 +1669,8 @@ static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
       free(p->data.string.x);
       break;
 
+    case MPC_TYPE_TRIE: mpc_trie_delete(p->data.trie.t); break;
+
     case MPC_TYPE_APPLY:    mpc_undefine_unretained(p->data.apply.x, 0);    break;
     case MPC_TYPE_APPLY_TO: mpc_undefine_unretained(p->data.apply_to.x, 0); break;
     case MPC_TYPE_PREDICT:  mpc_undefine_unretained(p->data.predict.x, 0);  break;
@@ -1502,6 +1779,8 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
       strcpy(p->data.string.x, a->data.string.x);
       break;
 
+    case MPC_TYPE_TRIE: p->data.trie.t = mpc_trie_copy(a->data.trie.t); break;
+
     case MPC_TYPE_APPLY:    p->data.apply.x    = mpc_copy(a->data.apply.x);    break;
     case MPC_TYPE_APPLY_TO: p->data.apply_to.x = mpc_copy(a->data.apply_to.x); break;
     case MPC_TYPE_PREDICT:  p->data.predict.x  = mpc_copy(a->data.predict.x);  break;
@@ -2752,6 +3031,14 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
     free(s);
   }
 
+  if (p->type == MPC_TYPE_TRIE) {
+    printf("(");
+    for(i = 0; i < p->data.trie.t->n; i++) {
+      printf(i == 0 ? "%s" : " | %s", p->data.trie.t->es[i]);
+    }
+    printf(")");
+  }
+
   if (p->type == MPC_TYPE_APPLY)    { mpc_print_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { mpc_print_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { mpc_print_unretained(p->data.predict.x, 0); }
@@ -2879,28 +3166,28 @@ void mpc_ast_delete(mpc_ast_t *a) {
     mpc_ast_delete(a->children[i]);
   }
 
-  free(a->children);
-  free(a->tag);
-  free(a->contents);
-  free(a);
+  mem_free(MEM_AST, a->children, sizeof(mpc_ast_t*) * a->children_num);
+  mem_free(MEM_AST, a->tag, strlen(a->tag) + 1);
+  mem_free(MEM_AST, a->contents, strlen(a->contents) + 1);
+  mem_free(MEM_AST, a, sizeof(mpc_ast_t));
 
 }
 
 static void mpc_ast_delete_no_children(mpc_ast_t *a) {
-  free(a->children);
-  free(a->tag);
-  free(a->contents);
-  free(a);
+  mem_free(MEM_AST, a->children, sizeof(mpc_ast_t*) * a->children_num);
+  mem_free(MEM_AST, a->tag, strlen(a->tag) + 1);
+  mem_free(MEM_AST, a->contents, strlen(a->contents) + 1);
+  mem_free(MEM_AST, a, sizeof(mpc_ast_t));
 }
 
 mpc_ast_t *mpc_ast_new(const char *tag, const char *contents) {
 
-  mpc_ast_t *a = malloc(sizeof(mpc_ast_t));
+  mpc_ast_t *a = mem_alloc(MEM_AST, sizeof(mpc_ast_t));
 
-  a->tag = malloc(strlen(tag) + 1);
+  a->tag = mem_alloc(MEM_AST, strlen(tag) + 1);
   strcpy(a->tag, tag);
 
-  a->contents = malloc(strlen(contents) + 1);
+  a->contents = mem_alloc(MEM_AST, strlen(contents) + 1);
   strcpy(a->contents, contents);
 
   a->state = mpc_state_new();
@@ -2959,14 +3246,14 @@ int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b) {
 
 mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a) {
   r->children_num++;
-  r->children = realloc(r->children, sizeof(mpc_ast_t*) * r->children_num);
+  r->children = mem_realloc(MEM_AST, r->children, sizeof(mpc_ast_t*) * (r->children_num-1), sizeof(mpc_ast_t*) * r->children_num);
   r->children[r->children_num-1] = a;
   return r;
 }
 
 mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
   if (a == NULL) { return a; }
-  a->tag = realloc(a->tag, strlen(t) + 1 + strlen(a->tag) + 1);
+  a->tag = mem_realloc(MEM_AST, a->tag, strlen(a->tag) + 1, strlen(t) + 1 + strlen(a->tag) + 1);
   memmove(a->tag + strlen(t) + 1, a->tag, strlen(a->tag)+1);
   memmove(a->tag, t, strlen(t));
   memmove(a->tag + strlen(t), "|", 1);
@@ -2975,14 +3262,14 @@ mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
 
 mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t) {
   if (a == NULL) { return a; }
-  a->tag = realloc(a->tag, (strlen(t)-1) + strlen(a->tag) + 1);
+  a->tag = mem_realloc(MEM_AST, a->tag, strlen(a->tag) + 1, (strlen(t)-1) + strlen(a->tag) + 1);
   memmove(a->tag + (strlen(t)-1), a->tag, strlen(a->tag)+1);
   memmove(a->tag, t, (strlen(t)-1));
   return a;
 }
 
 mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t) {
-  a->tag = realloc(a->tag, strlen(t) + 1);
+  a->tag = mem_realloc(MEM_AST, a->tag, strlen(a->tag) + 1, strlen(t) + 1);
   strcpy(a->tag, t);
   return a;
 }
@@ -3401,20 +3688,42 @@ static mpc_val_t *mpcaf_grammar_repeat(int n, mpc_val_t **xs) {
   return mpca_count(num, xs[0]);
 }
 
+/*
+** Literals are compiled to single entry tries
+** which `mpc_optimise` merges when they appear
+** as neighbouring alternatives of an `or`.
+*/
+
+static mpc_parser_t *mpca_trie(const char *x, const char *e, const char *tag, int tok) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_TRIE;
+  p->data.trie.t = mpc_trie_new(tok);
+  mpc_trie_insert(p->data.trie.t, x, e, tag);
+  return p;
+}
+
 static mpc_val_t *mpcaf_grammar_string(mpc_val_t *x, void *s) {
   mpca_grammar_st_t *st = s;
   char *y = mpcf_unescape(x);
-  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_string(y) : mpc_tok(mpc_string(y));
+  char *e = malloc(strlen(y) + 3);
+  mpc_parser_t *p;
+  sprintf(e, "\"%s\"", y);
+  p = mpca_trie(y, e, "string", !(st->flags & MPCA_LANG_WHITESPACE_SENSITIVE));
   free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "string"));
+  free(e);
+  return p;
 }
 
 static mpc_val_t *mpcaf_grammar_char(mpc_val_t *x, void *s) {
   mpca_grammar_st_t *st = s;
   char *y = mpcf_unescape(x);
-  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_char(y[0]) : mpc_tok(mpc_char(y[0]));
+  char c[2], e[4];
+  mpc_parser_t *p;
+  c[0] = y[0]; c[1] = '\0';
+  sprintf(e, "'%c'", y[0]);
+  p = mpca_trie(c, e, "char", !(st->flags & MPCA_LANG_WHITESPACE_SENSITIVE));
   free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "char"));
+  return p;
 }
 
 static mpc_val_t *mpcaf_fold_regex(int n, mpc_val_t **xs) {
@@ -3942,6 +4251,38 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       continue;
     }
 
+    /* Merge neighbouring `trie` alternatives */
+    if (p->type == MPC_TYPE_OR) {
+      for (i = 0; i < p->data.or.n-1; i++) {
+        if (p->data.or.xs[i]->type == MPC_TYPE_TRIE
+        && !p->data.or.xs[i]->retained
+        &&  p->data.or.xs[i+1]->type == MPC_TYPE_TRIE
+        && !p->data.or.xs[i+1]->retained
+        &&  p->data.or.xs[i]->data.trie.t->tok == p->data.or.xs[i+1]->data.trie.t->tok) { break; }
+      }
+      if (i < p->data.or.n-1) {
+        t = p->data.or.xs[i+1];
+        mpc_trie_merge(p->data.or.xs[i]->data.trie.t, t->data.trie.t);
+        mpc_delete(t);
+        memmove(p->data.or.xs + i + 1, p->data.or.xs + i + 2, (p->data.or.n - i - 2) * sizeof(mpc_parser_t*));
+        p->data.or.n--;
+        continue;
+      }
+    }
+
+    /* Remove single `trie` `or` */
+    if (p->type == MPC_TYPE_OR
+    &&  p->data.or.n == 1
+    &&  p->data.or.xs[0]->type == MPC_TYPE_TRIE
+    && !p->data.or.xs[0]->retained) {
+      t = p->data.or.xs[0];
+      free(p->data.or.xs);
+      p->type = t->type;
+      p->data = t->data;
+      free(t->name); free(t);
+      continue;
+    }
+
     /* Remove ast `pass` */
     if (p->type == MPC_TYPE_AND
     &&  p->data.and.n == 2
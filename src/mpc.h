@@ -53,6 +53,12 @@ void mpc_err_print_to(mpc_err_t *e, FILE *f);
 
 /*
 ** Parsing
+**
+** None of these write to the parser. Any number of
+** threads can parse with the same parser at once, each
+** call keeps its input state to itself and the result
+** belongs to the caller. Defining, copying, optimising
+** or deleting a parser while it is in use is not safe.
 */
 
 typedef void mpc_val_t;
@@ -65,11 +71,11 @@ typedef union {
 struct mpc_parser_t;
 typedef struct mpc_parser_t mpc_parser_t;
 
-int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r);
-int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r);
-int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result_t *r);
-int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r);
-int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r);
+int mpc_parse(const char *filename, const char *string, const mpc_parser_t *p, mpc_result_t *r);
+int mpc_nparse(const char *filename, const char *string, size_t length, const mpc_parser_t *p, mpc_result_t *r);
+int mpc_parse_file(const char *filename, FILE *file, const mpc_parser_t *p, mpc_result_t *r);
+int mpc_parse_pipe(const char *filename, FILE *pipe, const mpc_parser_t *p, mpc_result_t *r);
+int mpc_parse_contents(const char *filename, const mpc_parser_t *p, mpc_result_t *r);
 
 /*
 ** Function Types
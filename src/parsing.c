@@ -1,8 +1,26 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
 #include "mpc.h"
+#include "simd.h"
+#include "fmt.h"
+#include "pool.h"
+#include "mem.h"
 
 #define BUFSIZE 2048
-#define LASSERT(args, cond, err) \
-  if (!(cond)) { lval_del(args); return lval_err(err); }
+#define REDUCE_MIN 32   // below this many args a plain loop beats gathering for simd
+#define REDUCE_CHUNK 256
+#define PRINT_CHUNK 65536 // lval_stream hands output to the fd in pieces this big
+#define READ_CHUNK 65536  // batch mode reads its input this much at a time
+#define PAR_MIN 4096      // nodes under a sibling before --par-eval hands it to another thread
+#define PMAP_CHUNK 512    // elements per pmap/pfold task, fixed so results don't depend on the thread count
+#define SERVE_EVENTS 64   // epoll events taken per round of --serve
+#define SERVE_BACKLOG (16 << 20) // unsent reply bytes before --serve stops reading from a client
+#define SERVE_QUEUE 1024  // forms of one client waiting on the pool before --serve stops reading from it
+#define SERVE_INPUT (1 << 20) // bytes of one unfinished form --serve takes before giving up on the client
+#define LASSERT(args, cond, code, ctx) \
+  if (!(cond)) { lval_del(args); return lval_err(code, ctx); }
 
 #ifdef _WIN32
 
@@ -26,58 +44,310 @@ void add_history(char* unused){}
 #include <editline/history.h>
 #endif
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define open _open
+#define read _read
+#define close _close
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
 // lisp value
 typedef struct lval{
   int type;
+  uint32_t hash; // structural hash, cached once interned
   union{
     double num;
-    char* err;
+    int64_t inum;
+    int code; // LVAL_ERR, one of lval_err_types, sym holds its context
+    double* vec; // LVAL_VEC, count holds the length
   };
   char* sym;
   int count;
+  char interned; // owned by the hash-cons table, shared and never freed
   struct lval** cell;
 } lval;
 
+// profile of one builtin at one call depth, updated atomically
+typedef struct prof_stat {
+  int64_t calls;
+  int64_t incl_ns;
+  int64_t excl_ns; // minus the builtins it called on the same thread
+  int64_t bytes;   // of lvals it allocated itself
+} prof_stat;
+
+#define PROF_DEPTHS 16 // call depths profiled apart, deeper ones share the last
+
+// builtin registry, arity -1 takes any number of args
+typedef lval* (*lbuiltin_fn)(lval*);
+typedef struct lbuiltin {
+  char* name;
+  lbuiltin_fn fn;
+  int arity;
+  int flags;
+  prof_stat prof[PROF_DEPTHS];
+} lbuiltin;
+
+// memo only goes on pure builtins whose own work costs more than hashing and
+// copying their args, bench/memo shows which ones those are
+enum builtin_flags { BUILTIN_PURE = 1, BUILTIN_MEMO = 2 };
+
+// budget of one top-level evaluation, shared by every thread working on it
+typedef struct eval_limits {
+  long steps;      // sexprs reduced, atomic
+  long bytes;      // net bytes of lvals allocated, atomic
+  int64_t deadline; // now_ns() after which it's out of time
+  int tripped;     // code of the first limit hit, atomic
+} eval_limits;
+
 // ----- forward declarations -----
 
 int count_nodes(mpc_ast_t* t);
 
+int crno_run(mpc_ast_t* t);
+int crno_run_form(mpc_parser_t* p, char* name, char* src, long row, long col);
+int crno_batch(mpc_parser_t* p, char* path);
+int crno_serve(mpc_parser_t* p, char* path);
+int crno_batch_all(mpc_parser_t* p, char** paths, int n);
+void crno_batch_run(void* ctx, int i);
+void crno_batch_emit(void* ctx, int i);
+void crno_error(char* fmt, char* arg);
+
+int64_t now_ns(void);
+eval_limits* limit_begin(eval_limits* l);
+int limit_check(void);
+int limit_poll(void);
+void lval_charge(long n);
+
 lval* lval_num(double x);
-lval* lval_err(char* m);
+lval* lval_int(int64_t x);
+double lval_as_num(lval* v);
+lval* lval_err(int code, char* ctx);
+void lval_err_init(void);
 lval* lval_sym(char* s);
 lval* lval_sexpr(void);
 lval* lval_qexpr(void);
+lval* lval_copy(lval* v);
+lval* lval_vec(int n);
 void lval_del(lval* v);
+lval* lval_own(lval* v);
+
+uint32_t hash_mix(uint32_t h, uint32_t x);
+uint32_t hash_bits(uint32_t h, uint64_t x);
+uint32_t hash_str(uint32_t h, char* s);
+uint32_t lval_hash(lval* v);
+int lval_eq(lval* a, lval* b);
+lval* lval_intern(lval* v);
+lval* lval_intern_tree(lval* v);
+
+size_t lval_size(lval* v);
+lval* lval_keep(lval* v);
+lval* builtin_cached(lval* a, lbuiltin* b);
+int cache_scalars(lval* a);
 
 lval* lval_read_num(mpc_ast_t* t);
 lval* lval_read(mpc_ast_t* t);
 lval* lval_add(lval* v, lval* x);
+lval** lval_cells(lval** cell, int n);
+void lval_cells_free(lval** cell);
+double* lval_vec_buf(double* vec, int n);
 
-void lval_expr_print(lval* v, char open, char close);
+void lval_write_atom(fmt_buf* b, lval* v);
+int lval_stream(fmt_buf* b, lval* v, int fd);
+void lval_write(fmt_buf* b, lval* v);
 void lval_print(lval* v);
 void lval_println(lval* v);
 
 lval* lval_eval_sexpr(lval* v);
 lval* lval_eval(lval* v);
+int lval_cost(lval* v, int limit);
+char* lval_eval_par(lval* v, int* small);
+void lval_eval_task(void* ctx, int i);
+lval* lval_fold(lval* v);
+int lval_is_arith(lval* v);
+int lval_is_numeric(lval* v);
 lval* lval_pop(lval* v, int i);
 lval* lval_take(lval* v, int i);
 lval* lval_join(lval* x, lval* y);
+lval* lval_vec_join(lval* x, lval* y);
+lval* lval_vec_unpack(lval* v);
 
 // builtin funcs
+int lval_op(char* s);
+double lval_reduce(lval** c, int n, int op);
+int crno_register_builtin(char* name, lbuiltin_fn fn, int arity, int flags);
+lbuiltin* builtin_find(char* name);
+void builtin_init(void);
+char* builtin_grammar(char* fmt);
 lval* builtin(lval* a, char* func);
-lval* builtin_op(lval* a, char* op);
+lval* builtin_call(lval* a, lbuiltin* b);
+lval* builtin_profiled(lval* a, lbuiltin* b);
+int builtin_nullary(char* func);
+lval* builtin_op(lval* a, int op);
+lval* builtin_op_int(lval* a, int op);
+lval* builtin_op_promote(lval* a, int op, int i, double x);
+lval* builtin_add(lval* a);
+lval* builtin_sub(lval* a);
+lval* builtin_mul(lval* a);
+lval* builtin_div(lval* a);
+lval* builtin_mod(lval* a);
+lval* builtin_pow(lval* a);
+lval* builtin_min(lval* a);
+lval* builtin_max(lval* a);
+int lval_ipow(int64_t x, int64_t y, int64_t* res);
 lval* builtin_head(lval* a);
 lval* builtin_tail(lval* a);
 lval* builtin_list(lval* a);
 lval* builtin_eval(lval* a);
 lval* builtin_join(lval* a);
+lval* builtin_vec(lval* a);
+lval* builtin_vmap(lval* a, int op);
+lval* builtin_vadd(lval* a);
+lval* builtin_vmul(lval* a);
+lval* builtin_dot(lval* a);
+lval* builtin_sum(lval* a);
+lval* builtin_cache_stats(lval* a);
+lval* builtin_mem_stats(lval* a);
+lval* builtin_profile(lval* a);
+lval* builtin_profile_report(lval* a);
+void profile_reset(void);
+void profile_print(void);
+int lval_is_fn(lval* f);
+int lval_truthy(lval* v);
+lval* lval_apply(lval* f, lval* x, lval* y);
+lval* lval_map_range(lval* f, lval* xs, int lo, int hi);
+lval* lval_fold_range(lval* f, lval* acc, lval* xs, int lo, int hi);
+lval* builtin_map(lval* a);
+lval* builtin_filter(lval* a);
+lval* builtin_fold(lval* a);
+lval* builtin_pmap(lval* a);
+lval* builtin_pfold(lval* a);
+void builtin_pmap_task(void* ctx, int k);
 //lval eval_op(lval x, char* op, lval y);
 //lval eval(mpc_ast_t* t);
 
-enum lval_types { LVAL_NUM, LVAL_ERR, LVAL_SYM, LVAL_SEXPR, LVAL_QEXPR };
-enum lval_err_types { LERR_DIV_ZERO, LERR_BAD_OP, LERR_BAD_NUM };
-
+enum lval_types { LVAL_NUM, LVAL_ERR, LVAL_SYM, LVAL_SEXPR, LVAL_QEXPR, LVAL_VEC, LVAL_INT };
+enum lval_err_types {
+  LERR_DIV_ZERO, LERR_BAD_OP, LERR_BAD_NUM, LERR_NOT_NUM, LERR_NOT_SYM,
+  LERR_TOO_MANY, LERR_TOO_FEW, LERR_BAD_TYPE, LERR_EMPTY, LERR_VEC_LEN,
+  LERR_STEPS, LERR_MEM, LERR_TIME,
+  LERR_COUNT
+};
+enum lval_ops { LOP_ADD, LOP_SUB, LOP_MUL, LOP_DIV, LOP_MOD, LOP_POW, LOP_MIN, LOP_MAX, LOP_NONE };
+
+// runs lval_fold between read and eval, set by --fold
+int fold_consts = 0;
+
+// interns constants between read and eval, set by --hashcons
+int hash_cons = 0;
+
+// memoizes BUILTIN_MEMO calls, set by --cache, --cache-budget sets the size in bytes.
+// every thread has its own cache, so the budget is per thread
+int cache_on = 0;
+size_t cache_budget = 16 << 20;
+
+// threads evaluating batch inputs, set by --jobs
+int jobs = 1;
+
+// evaluates big sibling sexprs on the pool, set by --par-eval. --par-min sets
+// how many nodes a sibling needs before it's worth a task
+int par_eval = 0;
+int par_min = PAR_MIN;
+
+// unix socket to serve clients on instead of reading input, set by --serve
+char* serve_path = NULL;
+
+// mem.h counts allocations by kind for (mem-stats) while mem_on is set, by --mem-stats
+
+// counts calls, time and allocations of every builtin, set by --profile or (profile 1).
+// --profile also prints the report to stderr on exit
+int prof_on = 0;
+
+// limits on every top-level evaluation, 0 for none. --max-steps caps the sexprs
+// reduced, --max-mem the bytes of lvals alive at once and --max-time the milliseconds
+long max_steps = 0;
+long max_mem = 0;
+long max_time = 0;
+
+// budget of the evaluation this thread is working on, NULL when there are no limits
+POOL_LOCAL eval_limits* limits = NULL;
+
+// reused across prints so a warm repl doesn't allocate for output
+POOL_LOCAL fmt_buf out_buf = { NULL, 0, 0 };
+
+// where prints go, -1 keeps them in out_buf for whoever runs this thread to collect
+POOL_LOCAL int out_fd = 1;
+
+// batch errors are collected here instead of going to stderr when set
+POOL_LOCAL fmt_buf* err_buf = NULL;
+
+// grammar definition, %s is the sym rule generated from the builtin registry
+char* crno_lang =
+  "                                               \
+    num   : /-?([0-9]+(\\.[0-9]+)?|\\.[0-9]+)/ ;  \
+    sym   : %s ;                                  \
+    sexpr : '(' <expr>* ')' ;                     \
+    qexpr : '{' <expr>* '}' ;                     \
+    expr  : <num> | <sym> | <sexpr> | <qexpr> ;   \
+    crno  : /^/ <expr>* /$/ ;                     \
+  ";
+
+// printed when main gets a flag it doesn't know or one missing its value
+char* crno_usage =
+  "usage: crno [--strict-fp] [--fixed-fp] [--fold] [--hashcons] [--cache | --no-cache]\n"
+  "            [--cache-budget N] [--jobs N] [--par-eval] [--par-min N] [--serve PATH]\n"
+  "            [--max-steps N] [--max-mem N] [--max-time N] [--profile] [--mem-stats]\n"
+  "            [file | -]...\n";
+
+// the bench harnesses include this file for its internals and bring their own main
+#ifndef CRNO_NO_MAIN
 int main(int argc, char** argv){
+  // anything that isn't a flag is an input file, "-" is stdin. a flag it doesn't
+  // know or one missing its value exits with 2, the same as an unreadable input
+  char** files = malloc(sizeof(char*) * argc);
+  int inputs = 0;
+  for(int i = 1; i < argc; i++){
+    if(strncmp(argv[i], "--", 2) != 0) files[inputs++] = argv[i];
+    else if(strcmp(argv[i], "--strict-fp") == 0) simd_strict = 1;
+    else if(strcmp(argv[i], "--fixed-fp") == 0) fmt_fixed = 1;
+    else if(strcmp(argv[i], "--fold") == 0) fold_consts = 1;
+    else if(strcmp(argv[i], "--hashcons") == 0) hash_cons = 1;
+    else if(strcmp(argv[i], "--cache") == 0) cache_on = 1;
+    else if(strcmp(argv[i], "--no-cache") == 0) cache_on = 0;
+    else if(strcmp(argv[i], "--cache-budget") == 0 && i+1 < argc) cache_budget = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--jobs") == 0 && i+1 < argc) jobs = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--par-eval") == 0) par_eval = 1;
+    else if(strcmp(argv[i], "--par-min") == 0 && i+1 < argc) par_min = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--serve") == 0 && i+1 < argc) serve_path = argv[++i];
+    else if(strcmp(argv[i], "--max-steps") == 0 && i+1 < argc) max_steps = atol(argv[++i]);
+    else if(strcmp(argv[i], "--max-mem") == 0 && i+1 < argc) max_mem = atol(argv[++i]);
+    else if(strcmp(argv[i], "--max-time") == 0 && i+1 < argc) max_time = atol(argv[++i]);
+    else if(strcmp(argv[i], "--profile") == 0) prof_on = 1;
+    else if(strcmp(argv[i], "--mem-stats") == 0) mem_on = 1;
+    else{
+      crno_error("crno: bad option %s\n", argv[i]);
+      crno_error("%s", crno_usage);
+      free(files);
+      return 2;
+    }
+  }
+  if(prof_on) atexit(profile_print);
+  if(par_eval && jobs <= 1) jobs = pool_cpus();
+  // the server's own thread only polls, forms run on the workers
+  if(serve_path && jobs <= 1) jobs = pool_cpus() + 1;
+
   // grammar definition
   mpc_parser_t* Num = mpc_new("num");
   mpc_parser_t* Sym = mpc_new("sym");
@@ -86,18 +356,31 @@ int main(int argc, char** argv){
   mpc_parser_t* Expr = mpc_new("expr");
   mpc_parser_t* Crno = mpc_new("crno");
 
-  mpca_lang(MPCA_LANG_DEFAULT,
-    "                                              \
-      num   : /-?[0-9]*\.?[0-9]+/ ;                \
-      sym   : '+' | '-' | '*' | '/' | '%' | '^'    \
-            | \"list\" | \"head\" | \"tail\"       \
-            | \"join\" | \"eval\" ;                \
-      sexpr : '(' <expr>* ')' ;                    \
-      qexpr : '{' <expr>* '}' ;                    \
-      expr  : <num> | <sym> | <sexpr> | <qexpr> ;  \
-      crno  : /^/ <expr>* /$/ ;                    \
-    ",
-    Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  lval_err_init();
+  builtin_init();
+  char* lang = builtin_grammar(crno_lang);
+  mpca_lang(MPCA_LANG_DEFAULT, lang, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+  free(lang);
+
+  // workers live until exit, what they interned or cached stays theirs
+  if(jobs > 1) pool_start(jobs);
+
+  // server mode, clients send forms over a unix socket and get back what they print
+  if(serve_path){
+    int status = crno_serve(Crno, serve_path);
+    free(files);
+    mpc_cleanup(6, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+    return status;
+  }
+
+  // batch mode, each input is evaluated form by form without prompts
+  if(inputs){
+    int status = crno_batch_all(Crno, files, inputs);
+    free(files);
+    mpc_cleanup(6, Num, Sym, Sexpr, Qexpr, Expr, Crno);
+    return status;
+  }
+  free(files);
 
   // interactive prompt
   printf("Crno v9.9.9\nCTRL + C to quit\n");
@@ -114,10 +397,7 @@ int main(int argc, char** argv){
       // lval res = eval(r.output);
       // lval_println(res);
 
-      lval* x = lval_eval(lval_read(r.output));
-      lval_println(x);
-      lval_del(x);
-
+      crno_run(r.output);
       mpc_ast_delete(r.output);
     }else{
       mpc_err_print(r.error);
@@ -131,6 +411,600 @@ int main(int argc, char** argv){
   mpc_cleanup(6, Num, Sym, Sexpr, Qexpr, Expr, Crno);
   return 0;
 }
+#endif
+
+// ----- batch mode ----- //
+
+// read, fold, intern and eval one parsed input and print the result, 1 if it was an error
+int crno_run(mpc_ast_t* t){
+  lval* x = lval_read(t);
+  eval_limits l;
+  eval_limits* outer = limit_begin(&l);
+  if(fold_consts) x = lval_fold(x);
+  if(hash_cons) x = lval_intern_tree(x);
+  x = lval_eval(x);
+  int err = x->type == LVAL_ERR;
+  lval_println(x);
+  lval_del(x);
+  limits = outer;
+  return err;
+}
+
+// stderr, or err_buf when a worker is collecting the output of an input
+void crno_error(char* fmt, char* arg){
+  if(!err_buf){
+    fflush(stdout);
+    fprintf(stderr, fmt, arg);
+    return;
+  }
+  int n = snprintf(NULL, 0, fmt, arg);
+  fmt_reserve(err_buf, n+1);
+  snprintf(err_buf->data + err_buf->len, n+1, fmt, arg);
+  err_buf->len += n;
+}
+
+// parses and runs one top-level form that starts at row, col of the input,
+// parse errors are reported with positions in the input rather than the form
+int crno_run_form(mpc_parser_t* p, char* name, char* src, long row, long col){
+  mpc_result_t r;
+  if(!mpc_parse(name, src, p, &r)){
+    mpc_err_t* e = r.error;
+    if(e->state.row == 0) e->state.col += col;
+    e->state.row += row;
+    char* msg = mpc_err_string(e);
+    crno_error("%s", msg);
+    free(msg);
+    mpc_err_delete(e);
+    return 1;
+  }
+  int err = crno_run(r.output);
+  mpc_ast_delete(r.output);
+  return err;
+}
+
+// cuts top-level forms out of a stream of text. a form is a line, except a line
+// with open brackets carries on into the next ones
+typedef struct form_scan {
+  size_t pos;   // next byte to look at
+  size_t start; // where the current form began
+  int depth;
+  int in_form;
+  long row, col;           // position of pos in the whole stream
+  long form_row, form_col; // position of start
+} form_scan;
+
+// scans buf[pos, len) and returns 1 when a form is complete, it's buf[start, pos).
+// 0 when more input is needed, or when eof is set and nothing is left.
+// a form ends at a newline outside any brackets, or at eof where mpc gets to
+// complain about whatever is still open
+int form_next(form_scan* s, char* buf, size_t len, int eof){
+  while(s->pos < len){
+    char c = buf[s->pos];
+    if(c == '\n' && s->in_form && s->depth <= 0){
+      s->in_form = 0;
+      s->depth = 0;
+      return 1;
+    }
+    s->pos++;
+    if(!s->in_form && c != ' ' && c != '\t' && c != '\r' && c != '\n'){
+      s->in_form = 1;
+      s->start = s->pos - 1;
+      s->form_row = s->row;
+      s->form_col = s->col;
+    }
+    if(c == '(' || c == '{') s->depth++;
+    if(c == ')' || c == '}') s->depth--;
+    if(c == '\n'){ s->row++; s->col = 0; }
+    else s->col++;
+  }
+  if(eof && s->in_form){
+    s->in_form = 0;
+    s->depth = 0;
+    return 1;
+  }
+  return 0;
+}
+
+// drops everything before the form being read, returns how many bytes went
+size_t form_compact(form_scan* s, char* buf, size_t len){
+  size_t keep = s->in_form ? s->start : s->pos;
+  memmove(buf, buf + keep, len - keep);
+  s->pos -= keep;
+  if(s->in_form) s->start -= keep;
+  return keep;
+}
+
+// streams path ("-" for stdin) through the evaluator a form at a time, just
+// like typing it at the prompt. only the form being read is ever held in memory.
+// 0 when everything evaluated, 1 if any form failed, 2 if the input can't be read
+int crno_batch(mpc_parser_t* p, char* path){
+  int fd = strcmp(path, "-") == 0 ? 0 : open(path, O_RDONLY);
+  if(fd < 0){
+    crno_error("crno: can't open %s\n", path);
+    return 2;
+  }
+
+  size_t cap = READ_CHUNK * 2, len = 0;
+  char* buf = malloc(cap);
+  form_scan scan = { 0 };
+  int status = 0, eof = 0;
+
+  for(;;){
+    if(form_next(&scan, buf, len, eof)){
+      // there's always a spare byte past len for the terminator
+      char saved = buf[scan.pos];
+      buf[scan.pos] = '\0';
+      status |= crno_run_form(p, path, buf + scan.start, scan.form_row, scan.form_col);
+      buf[scan.pos] = saved;
+      continue;
+    }
+    if(eof) break;
+
+    // out of scanned bytes, drop what's been run and read more
+    len -= form_compact(&scan, buf, len);
+    if(cap - len < READ_CHUNK + 1){
+      cap *= 2;
+      buf = realloc(buf, cap);
+    }
+    int n = read(fd, buf + len, READ_CHUNK);
+    if(n < 0){
+      crno_error("crno: error reading %s\n", path);
+      status = 2;
+      break;
+    }
+    if(n == 0) eof = 1;
+    len += n;
+  }
+
+  free(buf);
+  if(fd != 0) close(fd);
+  return status;
+}
+
+// what a thread was collecting before it took a task that collects its own output.
+// a thread waiting on --par-eval tasks can pick one up halfway through another,
+// so the old output is put back when the task is done
+typedef struct capture {
+  int fd;
+  fmt_buf* err;
+  fmt_buf out;
+} capture;
+
+// prints stay in out_buf and errors go to err until capture_end
+void capture_begin(capture* c, fmt_buf* err){
+  c->fd = out_fd;
+  c->err = err_buf;
+  c->out = out_buf;
+  out_fd = -1;
+  err_buf = err;
+  out_buf = (fmt_buf){ NULL, 0, 0 };
+}
+
+// hands what was printed to out and restores the thread's own output
+void capture_end(capture* c, fmt_buf* out){
+  *out = out_buf;
+  out_buf = c->out;
+  out_fd = c->fd;
+  err_buf = c->err;
+}
+
+// one input of a parallel batch, its output waits here until it's its turn
+typedef struct batch_input {
+  char* path;
+  fmt_buf out;
+  fmt_buf err;
+  int status;
+} batch_input;
+
+typedef struct batch {
+  mpc_parser_t* p;
+  batch_input* in;
+  int status;
+} batch;
+
+// evaluates every input, with --jobs on a pool of threads that share the parser.
+// output is the same as running them one after the other, stdout and stderr
+// each get whole inputs in the order given. the worst status wins
+int crno_batch_all(mpc_parser_t* p, char** paths, int n){
+  if(pool_size() <= 1 || n == 1){
+    int status = 0;
+    for(int i = 0; i < n; i++){
+      int res = crno_batch(p, paths[i]);
+      if(res > status) status = res;
+    }
+    return status;
+  }
+
+  batch b = { p, calloc(n, sizeof(batch_input)), 0 };
+  for(int i = 0; i < n; i++) b.in[i].path = paths[i];
+
+  fflush(stdout);
+  pool_for(n, crno_batch_run, crno_batch_emit, &b);
+
+  free(b.in);
+  return b.status;
+}
+
+void crno_batch_run(void* ctx, int i){
+  batch* b = ctx;
+  batch_input* in = &b->in[i];
+  capture c;
+  capture_begin(&c, &in->err);
+  in->status = crno_batch(b->p, in->path);
+  capture_end(&c, &in->out);
+}
+
+void crno_batch_emit(void* ctx, int i){
+  batch* b = ctx;
+  batch_input* in = &b->in[i];
+  fmt_flush(&in->out, 1);
+  fmt_flush(&in->err, 2);
+  fmt_free(&in->out);
+  fmt_free(&in->err);
+  if(in->status > b->status) b->status = in->status;
+}
+
+// ----- server ----- //
+
+#ifdef __linux__
+
+// one connection, forms are cut out of in as they complete and replies queue up in out
+typedef struct client {
+  int fd;
+  int events;  // what epoll is watching it for, 0 when it isn't registered
+  int eof;     // the client is done sending
+  int dead;    // a read or write failed, dropped once its forms are back
+  int touched; // already in this round's list
+  int queued;  // forms on the pool or waiting for the ones before them
+  fmt_buf in;
+  form_scan scan;
+  fmt_buf out;
+  size_t sent; // bytes of out already written
+  struct serve_req* head; // forms in the order they came in, replies go out from here
+  struct serve_req* tail;
+  struct client* prev;
+  struct client* next;
+} client;
+
+// a form on its way through the pool, with whatever it printed once it has run
+typedef struct serve_req {
+  client* c;
+  mpc_parser_t* p;
+  char* src;
+  long row, col;
+  int done;    // set by the loop once it has come back
+  fmt_buf out;
+  fmt_buf err;
+  struct serve_req* next;     // next form of the same client
+  struct serve_req* finished; // next on serve_finished
+} serve_req;
+
+// clients something happened to in one pass over epoll's events, flushed together at the end
+typedef struct serve_round {
+  client** touched;
+  int ntouched, tcap;
+} serve_round;
+
+client* serve_clients = NULL;
+
+// SIGINT and SIGTERM land on any thread, a byte down this pipe wakes epoll_wait
+int serve_wake[2] = { -1, -1 };
+
+// workers push forms that have run here and drop a byte down serve_done,
+// the loop takes the whole stack at once when that wakes it
+serve_req* serve_finished = NULL;
+int serve_done[2] = { -1, -1 };
+int serve_inflight = 0; // forms handed to the pool and not back yet, only the loop touches it
+
+void serve_quit(int sig){
+  (void)sig;
+  char c = 0;
+  if(write(serve_wake[1], &c, 1) < 0) return;
+}
+
+void serve_nonblock(int fd){
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// something is already accepting connections at addr
+int serve_live(struct sockaddr_un* addr){
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  int live = fd >= 0 && connect(fd, (struct sockaddr*)addr, sizeof(*addr)) == 0;
+  if(fd >= 0) close(fd);
+  return live;
+}
+
+// registers, changes or drops what epoll watches c for
+void serve_watch(int ep, client* c, int events){
+  if(events == c->events) return;
+  struct epoll_event ev = { 0 };
+  ev.events = events;
+  ev.data.ptr = c;
+  epoll_ctl(ep, !c->events ? EPOLL_CTL_ADD : !events ? EPOLL_CTL_DEL : EPOLL_CTL_MOD, c->fd, &ev);
+  c->events = events;
+}
+
+// only once nothing on the pool points at c anymore
+void serve_close(int ep, client* c){
+  serve_watch(ep, c, 0);
+  close(c->fd);
+  if(c->prev) c->prev->next = c->next;
+  else serve_clients = c->next;
+  if(c->next) c->next->prev = c->prev;
+  fmt_free(&c->in);
+  fmt_free(&c->out);
+  free(c);
+}
+
+void serve_touch(serve_round* r, client* c){
+  if(c->touched) return;
+  if(r->ntouched == r->tcap){
+    r->tcap = r->tcap ? r->tcap * 2 : 64;
+    r->touched = realloc(r->touched, sizeof(client*) * r->tcap);
+  }
+  r->touched[r->ntouched++] = c;
+  c->touched = 1;
+}
+
+serve_req* serve_queue(client* c, mpc_parser_t* p){
+  serve_req* q = calloc(1, sizeof(serve_req));
+  q->c = c;
+  q->p = p;
+  if(c->tail) c->tail->next = q;
+  else c->head = q;
+  c->tail = q;
+  c->queued++;
+  return q;
+}
+
+// runs on a worker, then hands the form back to the loop
+void serve_task(void* ctx, int i){
+  (void)i;
+  serve_req* q = ctx;
+  capture c;
+  capture_begin(&c, &q->err);
+  crno_run_form(q->p, "<client>", q->src, q->row, q->col);
+  capture_end(&c, &q->out);
+
+  q->finished = __atomic_load_n(&serve_finished, __ATOMIC_RELAXED);
+  while(!__atomic_compare_exchange_n(&serve_finished, &q->finished, q, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  // a full pipe already has the loop's attention
+  char b = 0;
+  if(write(serve_done[1], &b, 1) < 0) return;
+}
+
+// one read per wakeup so a client sending a lot can't hold up the rest, every form
+// it completes goes to the pool on its own. a form that grows past SERVE_INPUT
+// without ending gets an error in its place and the client is read from no more
+void serve_read(mpc_parser_t* p, client* c){
+  fmt_reserve(&c->in, READ_CHUNK);
+  ssize_t n = read(c->fd, c->in.data + c->in.len, READ_CHUNK);
+  if(n < 0){
+    if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c->dead = 1;
+    return;
+  }
+  if(n == 0) c->eof = 1;
+  c->in.len += n;
+
+  form_scan* s = &c->scan;
+  while(form_next(s, c->in.data, c->in.len, c->eof)){
+    size_t len = s->pos - s->start;
+    serve_req* q = serve_queue(c, p);
+    q->src = malloc(len+1);
+    q->row = s->form_row;
+    q->col = s->form_col;
+    memcpy(q->src, c->in.data + s->start, len);
+    q->src[len] = '\0';
+    serve_inflight++;
+    pool_submit(serve_task, q, 0);
+  }
+  c->in.len -= form_compact(s, c->in.data, c->in.len);
+
+  if(c->in.len > SERVE_INPUT){
+    serve_req* q = serve_queue(c, p);
+    q->done = 1;
+    fmt_puts(&q->err, "crno: form longer than the server takes, closing\n");
+    c->eof = 1;
+    c->in.len = 0;
+  }
+}
+
+// takes everything the workers have finished since the last call
+void serve_collect(serve_round* r){
+  char b[64];
+  while(read(serve_done[0], b, sizeof(b)) > 0);
+  serve_req* q = __atomic_exchange_n(&serve_finished, NULL, __ATOMIC_ACQUIRE);
+  for(; q; q = q->finished){
+    q->done = 1;
+    serve_inflight--;
+    serve_touch(r, q->c);
+  }
+}
+
+void serve_append(client* c, fmt_buf* b){
+  if(!c->dead && b->len){
+    fmt_reserve(&c->out, b->len);
+    memcpy(c->out.data + c->out.len, b->data, b->len);
+    c->out.len += b->len;
+  }
+  fmt_free(b);
+}
+
+// moves the replies that are back into out, stopping at the first form still
+// running so they go out in the order the forms came in
+void serve_deliver(client* c){
+  while(c->head && c->head->done){
+    serve_req* q = c->head;
+    c->head = q->next;
+    if(!c->head) c->tail = NULL;
+    c->queued--;
+    serve_append(c, &q->out);
+    serve_append(c, &q->err);
+    free(q->src);
+    free(q);
+  }
+}
+
+// writes what the socket takes, then decides what to wait for next. a client
+// that's done sending and has all its replies is closed, one that's behind on
+// reading them or has SERVE_QUEUE forms waiting isn't read from until it catches up
+void serve_flush(int ep, client* c){
+  serve_deliver(c);
+  while(!c->dead && c->sent < c->out.len){
+    ssize_t n = write(c->fd, c->out.data + c->sent, c->out.len - c->sent);
+    if(n > 0) c->sent += n;
+    else if(n < 0 && errno == EINTR) continue;
+    else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    else c->dead = 1;
+  }
+  if(c->sent == c->out.len) c->sent = c->out.len = 0;
+
+  int events = 0;
+  if(!c->eof && c->out.len - c->sent < SERVE_BACKLOG && c->queued < SERVE_QUEUE) events |= EPOLLIN;
+  if(c->sent < c->out.len) events |= EPOLLOUT;
+  if(c->dead) events = 0;
+  // forms still on the pool point at c, it's closed when the last one is back
+  if(!events && !c->head){
+    serve_close(ep, c);
+    return;
+  }
+  serve_watch(ep, c, events);
+}
+
+// listens on a unix socket at path. clients send forms the same way batch input
+// is written and get back exactly what running it would print, in order. every
+// form goes to the pool as soon as it's read and its reply goes out as soon as
+// it and the ones sent before it are done, so the loop never waits on a slow
+// form and neither do other clients. runs until SIGINT or SIGTERM
+int crno_serve(mpc_parser_t* p, char* path){
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(addr.sun_path)){
+    crno_error("crno: socket path too long: %s\n", path);
+    return 2;
+  }
+  strcpy(addr.sun_path, path);
+
+  // a socket left behind by an earlier run is replaced, a live one or anything else isn't
+  struct stat st;
+  if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode) && !serve_live(&addr)) unlink(path);
+
+  int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(lfd < 0 || bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(lfd, SOMAXCONN) < 0){
+    crno_error("crno: can't listen on %s\n", path);
+    if(lfd >= 0) close(lfd);
+    return 2;
+  }
+  serve_nonblock(lfd);
+
+  int ep = epoll_create1(0);
+  if(ep < 0 || pipe(serve_wake) < 0 || pipe(serve_done) < 0){
+    crno_error("crno: can't serve %s\n", path);
+    close(lfd);
+    unlink(path);
+    return 2;
+  }
+  serve_nonblock(serve_wake[0]);
+  serve_nonblock(serve_wake[1]);
+  serve_nonblock(serve_done[0]);
+  serve_nonblock(serve_done[1]);
+  signal(SIGINT, serve_quit);
+  signal(SIGTERM, serve_quit);
+  signal(SIGPIPE, SIG_IGN);
+
+  // the listener is NULL, the pipes point at themselves, everything else is a client
+  struct epoll_event ev = { 0 };
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &ev);
+  ev.data.ptr = serve_wake;
+  epoll_ctl(ep, EPOLL_CTL_ADD, serve_wake[0], &ev);
+  ev.data.ptr = serve_done;
+  epoll_ctl(ep, EPOLL_CTL_ADD, serve_done[0], &ev);
+
+  serve_round r = { NULL, 0, 0 };
+  struct epoll_event evs[SERVE_EVENTS];
+  int quit = 0;
+  while(!quit){
+    int n = epoll_wait(ep, evs, SERVE_EVENTS, -1);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      break;
+    }
+
+    r.ntouched = 0;
+    for(int i = 0; i < n; i++){
+      if(evs[i].data.ptr == serve_wake){
+        quit = 1;
+        continue;
+      }
+      if(evs[i].data.ptr == serve_done){
+        serve_collect(&r);
+        continue;
+      }
+
+      if(!evs[i].data.ptr){
+        int fd;
+        while((fd = accept(lfd, NULL, NULL)) >= 0){
+          serve_nonblock(fd);
+          client* c = calloc(1, sizeof(client));
+          c->fd = fd;
+          c->next = serve_clients;
+          if(serve_clients) serve_clients->prev = c;
+          serve_clients = c;
+          serve_watch(ep, c, EPOLLIN);
+        }
+        continue;
+      }
+
+      client* c = evs[i].data.ptr;
+      if(!c->eof && (evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) serve_read(p, c);
+      serve_touch(&r, c);
+    }
+
+    for(int i = 0; i < r.ntouched; i++){
+      r.touched[i]->touched = 0;
+      serve_flush(ep, r.touched[i]);
+    }
+  }
+
+  // nothing more is read or written, but forms still running point at their clients
+  epoll_ctl(ep, EPOLL_CTL_DEL, lfd, NULL);
+  epoll_ctl(ep, EPOLL_CTL_DEL, serve_wake[0], NULL);
+  for(client* c = serve_clients; c; c = c->next){
+    c->dead = 1;
+    serve_watch(ep, c, 0);
+  }
+  while(serve_inflight > 0){
+    if(epoll_wait(ep, evs, 1, -1) < 0 && errno != EINTR) break;
+    r.ntouched = 0;
+    serve_collect(&r);
+  }
+  while(serve_clients){
+    serve_deliver(serve_clients);
+    serve_close(ep, serve_clients);
+  }
+  free(r.touched);
+  close(ep);
+  close(lfd);
+  close(serve_wake[0]);
+  close(serve_wake[1]);
+  close(serve_done[0]);
+  close(serve_done[1]);
+  unlink(path);
+  return 0;
+}
+
+#else
+
+int crno_serve(mpc_parser_t* p, char* path){
+  (void)p;
+  crno_error("crno: --serve %s needs epoll, which isn't available here\n", path);
+  return 2;
+}
+
+#endif
 
 // ----- misc functions ----- //
 
@@ -152,34 +1026,122 @@ int count_nodes(mpc_ast_t* t){
 
 // constructor for lval_num
 lval* lval_num(double x){
-  lval* v = malloc(sizeof(lval));
+  lval* v = mem_alloc(MEM_LVAL, sizeof(lval));
+  lval_charge(sizeof(lval));
   v->type = LVAL_NUM;
+  v->interned = 0;
   v->num = x;
   return v;
 }
 
-// constructor for lval_err
-lval* lval_err(char* m){
-  lval* v = malloc(sizeof(lval));
+// constructor for lval_int, exact 64-bit fixnum
+lval* lval_int(int64_t x){
+  lval* v = mem_alloc(MEM_LVAL, sizeof(lval));
+  lval_charge(sizeof(lval));
+  v->type = LVAL_INT;
+  v->interned = 0;
+  v->inum = x;
+  return v;
+}
+
+// numeric value of a num or int as a double
+double lval_as_num(lval* v){
+  return v->type == LVAL_INT ? (double)v->inum : v->num;
+}
+
+// error catalog, messages are printf formats for the error's context and
+// are only formatted when printed
+char* lerr_msgs[LERR_COUNT] = {
+  [LERR_DIV_ZERO] = "baka! division by zero",
+  [LERR_BAD_OP]   = "baka! unknown fun",
+  [LERR_BAD_NUM]  = "baka! invalid num",
+  [LERR_NOT_NUM]  = "baka! '%s' fun passed non-number!",
+  [LERR_NOT_SYM]  = "baka! sexpr does not start with sym!",
+  [LERR_TOO_MANY] = "baka! '%s' fun passed too many args!",
+  [LERR_TOO_FEW]  = "baka! '%s' fun passed too few args!",
+  [LERR_BAD_TYPE] = "baka! '%s' fun passed incorrect type!",
+  [LERR_EMPTY]    = "baka! '%s' fun passed {}!",
+  [LERR_VEC_LEN]  = "baka! '%s' fun passed vecs of different lengths!",
+  [LERR_STEPS]    = "baka! step limit reached!",
+  [LERR_MEM]      = "baka! memory limit reached!",
+  [LERR_TIME]     = "baka! time limit reached!",
+};
+
+// errors are shared and never freed, like interned values. context-free
+// ones are preallocated, the rest are made once per (code, ctx) and reused
+// by the thread that made them
+lval lerr_static[LERR_COUNT];
+POOL_LOCAL lval** lerr_tab = NULL;
+POOL_LOCAL int lerr_slots = 0;
+POOL_LOCAL int lerr_count = 0;
+
+void lval_err_init(void){
+  for(int i = 0; i < LERR_COUNT; i++){
+    lval* v = &lerr_static[i];
+    v->type = LVAL_ERR;
+    v->code = i;
+    v->sym = NULL;
+    v->interned = 0;
+    v->hash = lval_hash(v);
+    v->interned = 1;
+  }
+}
+
+void lval_err_grow(void){
+  int slots = lerr_slots ? lerr_slots * 2 : 64;
+  lval** tab = mem_calloc(MEM_ERR, slots, sizeof(lval*));
+  for(int i = 0; i < lerr_slots; i++){
+    if(!lerr_tab[i]) continue;
+    int j = hash_bits(lerr_tab[i]->code, (uintptr_t)lerr_tab[i]->sym) & (slots-1);
+    while(tab[j]) j = (j+1) & (slots-1);
+    tab[j] = lerr_tab[i];
+  }
+  mem_free(MEM_ERR, lerr_tab, sizeof(lval*) * lerr_slots);
+  lerr_tab = tab;
+  lerr_slots = slots;
+}
+
+// constructor for lval_err, ctx is borrowed and must outlive the error
+lval* lval_err(int code, char* ctx){
+  mem_hit(MEM_ERR);
+  if(!ctx) return &lerr_static[code];
+
+  if(lerr_count * 2 >= lerr_slots) lval_err_grow();
+  int i = hash_bits(code, (uintptr_t)ctx) & (lerr_slots-1);
+  while(lerr_tab[i]){
+    if(lerr_tab[i]->code == code && lerr_tab[i]->sym == ctx) return lerr_tab[i];
+    i = (i+1) & (lerr_slots-1);
+  }
+
+  lval* v = mem_alloc(MEM_ERR, sizeof(lval));
   v->type = LVAL_ERR;
-  v->err = malloc(strlen(m)+1); //ensure space for \0
-  strcpy(v->err, m);
+  v->code = code;
+  v->sym = ctx;
+  v->interned = 0;
+  v->hash = lval_hash(v);
+  v->interned = 1;
+  lerr_tab[i] = v;
+  lerr_count++;
   return v;
 }
 
 // constructor for lval_sym
 lval* lval_sym(char* s){
-  lval* v = malloc(sizeof(lval));
+  lval* v = mem_alloc(MEM_LVAL, sizeof(lval));
+  lval_charge(sizeof(lval) + strlen(s)+1);
   v->type = LVAL_SYM;
-  v->sym = malloc(strlen(s)+1); //ensure space for \0
+  v->interned = 0;
+  v->sym = mem_alloc(MEM_LVAL, strlen(s)+1); //ensure space for \0
   strcpy(v->sym, s);
   return v;
 }
 
 // constructor for lval_sexpr
 lval* lval_sexpr(void){
-  lval* v = malloc(sizeof(lval));
+  lval* v = mem_alloc(MEM_LVAL, sizeof(lval));
+  lval_charge(sizeof(lval));
   v->type = LVAL_SEXPR;
+  v->interned = 0;
   v->count = 0;
   v->cell = NULL;
   return v;
@@ -187,35 +1149,106 @@ lval* lval_sexpr(void){
 
 // constructor for lval_qexpr
 lval* lval_qexpr(void){
-  lval* v = malloc(sizeof(lval));
+  lval* v = mem_alloc(MEM_LVAL, sizeof(lval));
+  lval_charge(sizeof(lval));
   v->type = LVAL_QEXPR;
+  v->interned = 0;
   v->count = 0;
   v->cell = NULL;
   return v;
 }
 
+// constructor for lval_vec, n uninitialized doubles in one aligned buffer
+lval* lval_vec(int n){
+  lval* v = mem_alloc(MEM_LVAL, sizeof(lval));
+  lval_charge(sizeof(lval) + sizeof(double) * n);
+  v->type = LVAL_VEC;
+  v->interned = 0;
+  v->count = n;
+  v->vec = lval_vec_buf(NULL, n);
+  v->cell = NULL;
+  return v;
+}
+
+// deep copy of any lvalue, interned children are shared rather than copied
+lval* lval_copy(lval* v){
+  lval* x = mem_alloc(MEM_LVAL, sizeof(lval));
+  lval_charge(sizeof(lval) + (v->type == LVAL_VEC ? sizeof(double) * v->count : 0)
+              + (v->type == LVAL_SYM ? strlen(v->sym)+1 : 0));
+  x->type = v->type;
+  x->interned = 0;
+  switch(v->type){
+    case LVAL_NUM: x->num = v->num; break;
+    case LVAL_INT: x->inum = v->inum; break;
+    case LVAL_ERR:
+      x->code = v->code;
+      x->sym = v->sym;
+      break;
+    case LVAL_SYM:
+      x->sym = mem_alloc(MEM_LVAL, strlen(v->sym)+1);
+      strcpy(x->sym, v->sym);
+      break;
+    case LVAL_VEC:
+      x->count = v->count;
+      x->vec = lval_vec_buf(NULL, v->count);
+      memcpy(x->vec, v->vec, sizeof(double) * v->count);
+      x->cell = NULL;
+      break;
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+      x->count = v->count;
+      x->cell = lval_cells(NULL, v->count);
+      for(int i = 0; i < v->count; i++) x->cell[i] = lval_keep(v->cell[i]);
+      break;
+  }
+  return x;
+}
+
 // destructor for lvalues
 void lval_del(lval* v){
+  if(v->interned) return;
+  long n = sizeof(lval);
   switch(v->type){
     case LVAL_NUM: break;
-    case LVAL_ERR: free(v->err); break;
-    case LVAL_SYM: free(v->sym); break;
+    case LVAL_INT: break;
+    case LVAL_ERR: break;
+    case LVAL_SYM:
+      n += strlen(v->sym)+1;
+      mem_free(MEM_LVAL, v->sym, strlen(v->sym)+1);
+      break;
+    case LVAL_VEC:
+      n += sizeof(double) * v->count;
+      if(mem_on) mem_count(MEM_LVAL, 0, 1, 0, -(long)simd_size(v->vec));
+      simd_free(v->vec);
+      break;
 
     case LVAL_QEXPR:
     case LVAL_SEXPR:
       for(int i = 0; i < v->count; i++)
         lval_del(v->cell[i]);
-      free(v->cell);
+      lval_cells_free(v->cell);
       break;
   }
-  free(v);
+  lval_charge(-n);
+  mem_free(MEM_LVAL, v, sizeof(lval));
+}
+
+// private copy of v if it's shared, anything about to be mutated goes through here
+lval* lval_own(lval* v){
+  return v->interned ? lval_copy(v) : v;
 }
 
-// aux function to ensure proper strtod conversion
+// aux function to ensure proper conversion, literals without a '.' are ints
 lval* lval_read_num(mpc_ast_t* t){
   errno = 0;
-  double x = strtod(t->contents, NULL);
-  return errno != ERANGE ? lval_num(x) : lval_err("baka! invalid num");
+  if(!strchr(t->contents, '.')){
+    long long i = strtoll(t->contents, NULL, 10);
+    // an int has no -0, so "-0" stays the double it was before ints
+    if(errno != ERANGE && !(i == 0 && t->contents[0] == '-')) return lval_int(i);
+    errno = 0; // too big for int64, read it as a double instead
+  }
+  double x = fmt_strtod(t->contents, NULL);
+  return errno != ERANGE ? lval_num(x) : lval_err(LERR_BAD_NUM, NULL);
 }
 
 // reads lvalues with sexpr now supported
@@ -248,52 +1281,198 @@ lval* lval_read(mpc_ast_t* t){
 // aux function to add values to a list created by root or sexpr
 lval* lval_add(lval* v, lval* x){
   v->count++;
-  v->cell = realloc(v->cell, sizeof(lval*) * v->count);
+  v->cell = lval_cells(v->cell, v->count);
   v->cell[v->count-1] = x;
   return v;
 }
 
-void lval_expr_print(lval* v, char open, char close){
-  putchar(open);
-  for(int i = 0; i < v->count; i++){
-    lval_print(v->cell[i]);
-    if(i != (v->count-1)) putchar(' '); //dont print space if last element
+// cell arrays and vec buffers stay on malloc and are counted by what it reserved.
+// filter and the parallel evaluator drop cells without shrinking the array, so
+// nothing else knows how big it is by the time it's freed. malloc is only asked
+// when --mem-stats or --max-mem needs the answer
+lval** lval_cells(lval** cell, int n){
+  if(cell && !n){
+    lval_cells_free(cell);
+    return NULL;
   }
-  putchar(close);
+  if(!mem_on && !max_mem) return realloc(cell, sizeof(lval*) * n);
+  long old = mem_block(cell);
+  cell = realloc(cell, sizeof(lval*) * n);
+  long grew = (long)mem_block(cell) - old;
+  mem_count(MEM_LVAL, 1, 0, sizeof(lval*) * n, grew);
+  lval_charge(grew);
+  return cell;
 }
 
-// prints lvalues based on their type, the lion doesn't concern himself with error handling
-void lval_print(lval* v){
+void lval_cells_free(lval** cell){
+  if(!cell) return;
+  if(!mem_on && !max_mem){
+    free(cell);
+    return;
+  }
+  long n = mem_block(cell);
+  mem_count(MEM_LVAL, 0, 1, 0, -n);
+  lval_charge(-n);
+  free(cell);
+}
+
+double* lval_vec_buf(double* vec, int n){
+  if(!mem_on) return simd_realloc(vec, n);
+  long old = simd_size(vec);
+  vec = simd_realloc(vec, n);
+  mem_count(MEM_LVAL, 1, 0, sizeof(double) * n, (long)simd_size(vec) - old);
+  return vec;
+}
+
+// anything that isn't a list or a vec, the lion doesn't concern himself with error handling
+void lval_write_atom(fmt_buf* b, lval* v){
   switch(v->type){
-    case LVAL_NUM:   printf("%lf", v->num); break;
-    case LVAL_ERR:   printf("baka! %s", v->err); break;
-    case LVAL_SYM:   printf("%s", v->sym); break;
-    case LVAL_SEXPR: lval_expr_print(v, '(', ')'); break;
-    case LVAL_QEXPR: lval_expr_print(v, '{', '}'); break;
+    case LVAL_NUM: fmt_double(b, v->num); break;
+    // --fixed-fp prints every number the "%lf" way, ints too
+    case LVAL_INT: if(fmt_fixed) fmt_double(b, (double)v->inum); else fmt_int(b, v->inum); break;
+    case LVAL_SYM: fmt_puts(b, v->sym); break;
+    case LVAL_ERR: {
+      fmt_puts(b, "baka! ");
+      int n = snprintf(NULL, 0, lerr_msgs[v->code], v->sym);
+      fmt_reserve(b, n+1);
+      snprintf(b->data + b->len, n+1, lerr_msgs[v->code], v->sym);
+      b->len += n;
+      break;
+    }
   }
 }
 
-void lval_println(lval* v){ lval_print(v); putchar('\n'); }
+// i is the next child to print, -1 before the opening bracket
+typedef struct {
+  lval* v;
+  int i;
+} print_frame;
+
+// serializes v into b walking it with an explicit stack, so depth costs no
+// c stack. with fd >= 0 every PRINT_CHUNK bytes go out as they're made, the
+// text of a huge value never sits in memory at once. -1 if the fd fails
+int lval_stream(fmt_buf* b, lval* v, int fd){
+  if(v->type != LVAL_SEXPR && v->type != LVAL_QEXPR && v->type != LVAL_VEC){
+    lval_write_atom(b, v);
+    return 0;
+  }
+
+  int cap = 16, top = 0;
+  print_frame* st = malloc(sizeof(print_frame) * cap);
+  st[top++] = (print_frame){ v, -1 };
+
+  int res = 0;
+  while(top){
+    print_frame* f = &st[top-1];
+    lval* x = f->v;
+    char open = x->type == LVAL_VEC ? '[' : x->type == LVAL_QEXPR ? '{' : '(';
+    char close = x->type == LVAL_VEC ? ']' : x->type == LVAL_QEXPR ? '}' : ')';
+
+    if(f->i < 0){
+      fmt_putc(b, open);
+      f->i = 0;
+    }else if(f->i == x->count){
+      fmt_putc(b, close);
+      top--;
+    }else{
+      if(f->i) fmt_putc(b, ' '); //dont print space before the first element
+      if(x->type == LVAL_VEC){
+        fmt_double(b, x->vec[f->i++]);
+      }else{
+        lval* c = x->cell[f->i++];
+        if(c->type == LVAL_SEXPR || c->type == LVAL_QEXPR || c->type == LVAL_VEC){
+          if(top == cap){
+            cap *= 2;
+            st = realloc(st, sizeof(print_frame) * cap);
+          }
+          st[top++] = (print_frame){ c, -1 };
+        }else{
+          lval_write_atom(b, c);
+        }
+      }
+    }
+
+    if(fd >= 0 && b->len >= PRINT_CHUNK && fmt_flush(b, fd) < 0){ res = -1; break; }
+  }
+
+  free(st);
+  return res;
+}
+
+// whole value into b
+void lval_write(fmt_buf* b, lval* v){
+  lval_stream(b, v, -1);
+}
+
+// streamed to stdout in chunks, stdio is flushed first so the prompt stays in order
+void lval_print(lval* v){
+  if(out_fd >= 0) fflush(stdout);
+  lval_stream(&out_buf, v, out_fd);
+  if(out_fd >= 0) fmt_flush(&out_buf, out_fd);
+}
+
+void lval_println(lval* v){
+  if(out_fd >= 0) fflush(stdout);
+  lval_stream(&out_buf, v, out_fd);
+  fmt_putc(&out_buf, '\n');
+  if(out_fd >= 0) fmt_flush(&out_buf, out_fd);
+}
+
+// above zero while evaluating a subtree too small to be worth splitting
+POOL_LOCAL int par_small = 0;
 
 // special eval for sexpr
 lval* lval_eval_sexpr(lval* v){
-  for(int i = 0; i < v->count; i++)
-    v->cell[i] = lval_eval(v->cell[i]);
-  for(int i = 0; i < v->count; i++)
-    if(v->cell[i]->type == LVAL_ERR) return lval_take(v, i);
+  int over = limit_check();
+  if(over){
+    lval_del(v);
+    return lval_err(over, NULL);
+  }
+
+  // with --par-eval the big siblings are evaluated first on the pool,
+  // the loop below skips them
+  int small = 0;
+  char* ready = par_eval && !par_small && v->count > 1 ? lval_eval_par(v, &small) : NULL;
+  par_small += small;
+
+  // stop at the first error, the siblings after it are never evaluated
+  lval* err = NULL;
+  for(int i = 0; i < v->count; i++){
+    if(!(ready && ready[i])) v->cell[i] = lval_eval(v->cell[i]);
+    if(v->cell[i]->type == LVAL_ERR){
+      // everything else is thrown away, no need to keep the order
+      err = v->cell[i];
+      v->cell[i] = v->cell[--v->count];
+      break;
+    }
+  }
+  par_small -= small;
+  free(ready);
+  if(err){
+    lval_del(v);
+    return err;
+  }
   
   if(v->count == 0) return v; //empty expr
-  if(v->count == 1) return lval_take(v, 0); //single expr
+  if(v->count == 1 && !(v->cell[0]->type == LVAL_SYM && builtin_nullary(v->cell[0]->sym)))
+    return lval_take(v, 0); //single expr
 
   // ensure first elem is sym
   lval* f = lval_pop(v, 0);
   if(f->type != LVAL_SYM){
     lval_del(f); lval_del(v);
-    return lval_err("baka! sexpr does not start with sym!");
+    return lval_err(LERR_NOT_SYM, NULL);
   }
 
   lval* res = builtin(v, f->sym); //builtin deals with op
   lval_del(f);
+
+  // a builtin that allocates a lot in one go, or stopped early on a limit with
+  // whatever it had so far, only shows up after it returns
+  if(limits && res->type != LVAL_ERR && (over = __atomic_load_n(&limits->tripped, __ATOMIC_RELAXED))){
+    lval_del(res);
+    return lval_err(over, NULL);
+  }
   return res;
 }
 
@@ -301,6 +1480,208 @@ lval* lval_eval(lval* v){
   return v->type == LVAL_SEXPR ? lval_eval_sexpr(v) : v;
 }
 
+// nodes in v, counting stops once limit is reached
+int lval_cost(lval* v, int limit){
+  int n = 1;
+  if(v->type != LVAL_SEXPR && v->type != LVAL_QEXPR) return n;
+  for(int i = 0; i < v->count && n < limit; i++) n += lval_cost(v->cell[i], limit - n);
+  return n;
+}
+
+typedef struct par_job {
+  lval* v;
+  int* idx;
+  eval_limits* limits;
+} par_job;
+
+// tasks count against the budget of the evaluation that made them
+void lval_eval_task(void* ctx, int i){
+  par_job* j = ctx;
+  eval_limits* outer = limits;
+  limits = j->limits;
+  j->v->cell[j->idx[i]] = lval_eval(j->v->cell[j->idx[i]]);
+  limits = outer;
+}
+
+// evaluates the sexpr children of v with at least par_min nodes as pool tasks
+// and returns which cells are done, NULL when fewer than two are that big.
+// sets *small when none of them came close, nothing under v needs checking then
+char* lval_eval_par(lval* v, int* small){
+  if(pool_size() <= 1) return NULL;
+
+  int* idx = malloc(sizeof(int) * v->count);
+  int n = 0;
+  for(int i = 0; i < v->count; i++){
+    if(v->cell[i]->type == LVAL_SEXPR && lval_cost(v->cell[i], par_min) >= par_min) idx[n++] = i;
+  }
+  if(n < 2){
+    *small = n == 0;
+    free(idx);
+    return NULL;
+  }
+
+  // siblings share nothing, each task owns its cell until pool_for returns
+  par_job job = { v, idx, limits };
+  pool_for(n, lval_eval_task, NULL, &job);
+
+  char* ready = calloc(v->count, 1);
+  for(int i = 0; i < n; i++) ready[idx[i]] = 1;
+  free(idx);
+  return ready;
+}
+
+// ----- limits ----- //
+
+// monotonic wall clock, clock() is wall time on windows
+int64_t now_ns(void){
+#ifdef _WIN32
+  return (int64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+
+// makes l the budget of a new top-level evaluation when any limit is set,
+// returns the one to put back in limits once it's done
+eval_limits* limit_begin(eval_limits* l){
+  eval_limits* outer = limits;
+  if(!max_steps && !max_mem && !max_time) return outer;
+  *l = (eval_limits){ 0, 0, now_ns() + (int64_t)max_time * 1000000, 0 };
+  limits = l;
+  return outer;
+}
+
+// only the first limit hit is reported
+void limit_trip(eval_limits* l, int code){
+  int none = 0;
+  __atomic_compare_exchange_n(&l->tripped, &none, code, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+// counts one reduction, returns the error code once any limit is hit and 0 until then.
+// the clock is read on the first step and every 256 after it
+int limit_check(void){
+  eval_limits* l = limits;
+  if(!l) return 0;
+  long s = __atomic_add_fetch(&l->steps, 1, __ATOMIC_RELAXED);
+  if(max_steps && s > max_steps) limit_trip(l, LERR_STEPS);
+  if(max_time && (s & 255) == 1 && now_ns() > l->deadline) limit_trip(l, LERR_TIME);
+  return __atomic_load_n(&l->tripped, __ATOMIC_RELAXED);
+}
+
+// the error code of any limit hit so far, reading the clock without counting a step.
+// builtins that loop without reducing poll this and return early, whatever they
+// return is replaced with the error
+int limit_poll(void){
+  eval_limits* l = limits;
+  if(!l) return 0;
+  if(max_time && now_ns() > l->deadline) limit_trip(l, LERR_TIME);
+  return __atomic_load_n(&l->tripped, __ATOMIC_RELAXED);
+}
+
+// bytes of lvals this thread has allocated while profiling
+POOL_LOCAL int64_t prof_bytes = 0;
+
+// n bytes of lvals allocated, or freed when negative. going over the quota
+// is noticed at the next reduction, which unwinds like any other error
+void lval_charge(long n){
+  if(n > 0 && __atomic_load_n(&prof_on, __ATOMIC_RELAXED)) prof_bytes += n;
+  eval_limits* l = limits;
+  if(!l) return;
+  long bytes = __atomic_add_fetch(&l->bytes, n, __ATOMIC_RELAXED);
+  if(max_mem && bytes > max_mem) limit_trip(l, LERR_MEM);
+}
+
+// ----- constant folding ----- //
+
+int lval_is_numeric(lval* v){
+  return v->type == LVAL_NUM || v->type == LVAL_INT;
+}
+
+// (op arg...) with an arithmetic op, evaluates to a number or an error
+int lval_is_arith(lval* v){
+  return v->type == LVAL_SEXPR && v->count >= 2
+      && v->cell[0]->type == LVAL_SYM && lval_op(v->cell[0]->sym) != LOP_NONE;
+}
+
+// simplifies a freshly read tree before eval. every rewrite gives the
+// same value and the same error as evaluating the original would.
+// qexprs are data and are only touched when eval turns them into code.
+lval* lval_fold(lval* v){
+  if(v->type != LVAL_SEXPR) return v;
+
+  for(int i = 0; i < v->count; i++) v->cell[i] = lval_fold(v->cell[i]);
+
+  if(v->count == 0) return v;
+  // (x) -> x, eval does the same thing
+  if(v->count == 1 && !(v->cell[0]->type == LVAL_SYM && builtin_nullary(v->cell[0]->sym)))
+    return lval_fold(lval_take(v, 0));
+  if(v->cell[0]->type != LVAL_SYM) return v;
+  char* f = v->cell[0]->sym;
+
+  // (eval {...}) -> (...)
+  if(v->count == 2 && strcmp(f, "eval") == 0 && v->cell[1]->type == LVAL_QEXPR){
+    lval* x = lval_take(v, 1);
+    x->type = LVAL_SEXPR;
+    return lval_fold(x);
+  }
+
+  // (head (list a b...)) -> (list a), only when b... can't fail to evaluate
+  if(v->count == 2 && strcmp(f, "head") == 0 && v->cell[1]->type == LVAL_SEXPR){
+    lval* l = v->cell[1];
+    int pure = l->count >= 2 && l->cell[0]->type == LVAL_SYM && strcmp(l->cell[0]->sym, "list") == 0;
+    for(int i = 2; pure && i < l->count; i++) pure = l->cell[i]->type != LVAL_SEXPR;
+    if(pure){
+      while(l->count > 2) lval_del(lval_pop(l, 2));
+      return lval_take(v, 1);
+    }
+  }
+
+  int op = lval_op(f);
+  if(op == LOP_NONE) return v;
+
+  // (op (op a b) c) -> (op a b c) for the associative ops. only the first
+  // arg, so the left-to-right order is kept, and only when a b are numeric
+  // so the inner call can't fail its type check before c is evaluated.
+  // float + and * past REDUCE_MIN args are reassociated by the simd kernels,
+  // so they're only merged that far with --strict-fp.
+  // an all int inner call is summed exactly before the outer one turns it into
+  // a double, merged its ints would be converted one by one, so it's only merged
+  // when the inner call has a float literal or every outer arg is an int literal
+  if((op == LOP_ADD || op == LOP_MUL || op == LOP_MIN || op == LOP_MAX)
+     && lval_is_arith(v->cell[1]) && lval_op(v->cell[1]->cell[0]->sym) == op){
+    lval* in = v->cell[1];
+    int flat = op == LOP_MIN || op == LOP_MAX || simd_strict || v->count + in->count - 3 <= REDUCE_MIN;
+    int num = 0, ints = 1;
+    for(int i = 1; flat && i < in->count; i++){
+      flat = lval_is_numeric(in->cell[i]) || lval_is_arith(in->cell[i]);
+      num |= in->cell[i]->type == LVAL_NUM;
+    }
+    for(int i = 2; i < v->count; i++) ints &= v->cell[i]->type == LVAL_INT;
+    if(flat && (num || ints)){
+      int m = in->count - 1;
+      v->cell = lval_cells(v->cell, v->count + m - 1);
+      memmove(&v->cell[1+m], &v->cell[2], sizeof(lval*) * (v->count - 2));
+      memcpy(&v->cell[1], &in->cell[1], sizeof(lval*) * m);
+      v->count += m - 1;
+      // its args moved to v, only the op symbol is left to free
+      in->count = 1;
+      lval_del(in);
+    }
+  }
+
+  // all literal args -> result, unless it errors, then eval can report it later.
+  // only for pure builtins, the op names can be registered over with anything
+  lbuiltin* b = builtin_find(f);
+  if(!b || !(b->flags & BUILTIN_PURE)) return v;
+  for(int i = 1; i < v->count; i++) if(!lval_is_numeric(v->cell[i])) return v;
+  lval* x = lval_eval(lval_copy(v));
+  if(x->type == LVAL_ERR){ lval_del(x); return v; }
+  lval_del(v);
+  return x;
+}
+
 lval* lval_pop(lval* v, int i){
   // get top item
   lval* x = v->cell[i];
@@ -308,9 +1689,10 @@ lval* lval_pop(lval* v, int i){
   // shift mem and realloc
   memmove(&v->cell[i], &v->cell[i+1], sizeof(lval*) * (v->count-i-1));
   v->count--;
-  v->cell = realloc(v->cell, sizeof(lval*) * v->count);
+  v->cell = lval_cells(v->cell, v->count);
 
-  return x;
+  // callers own what they pop, so shared values come out as copies
+  return lval_own(x);
 }
 
 lval* lval_take(lval* v, int i){
@@ -320,80 +1702,665 @@ lval* lval_take(lval* v, int i){
 }
 
 lval* lval_join(lval* x, lval* y){
-  while(y->count) x = lval_add(x, lval_pop(y, 0));
+  while(y->count && !limit_poll()) x = lval_add(x, lval_pop(y, 0));
+
+  lval_del(y);
+  return x;
+}
 
+// appends y's elements to x, both vecs, one realloc and one memcpy
+lval* lval_vec_join(lval* x, lval* y){
+  x->vec = lval_vec_buf(x->vec, x->count + y->count);
+  lval_charge(sizeof(double) * y->count);
+  memcpy(x->vec + x->count, y->vec, sizeof(double) * y->count);
+  x->count += y->count;
   lval_del(y);
   return x;
 }
 
+// converts a vec into the equivalent qexpr of nums
+lval* lval_vec_unpack(lval* v){
+  lval* q = lval_qexpr();
+  q->cell = lval_cells(NULL, v->count);
+  // a limit stops it short, the caller's result is replaced with the error
+  while(q->count < v->count && !limit_poll()){
+    q->cell[q->count] = lval_num(v->vec[q->count]);
+    q->count++;
+  }
+  lval_del(v);
+  return q;
+}
+
+// ----- structural hashing ----- //
+
+// nums, ints and qexprs made only of those are immutable once read, so with
+// --hashcons every distinct one is kept once in a table and shared. interned
+// values are never freed and lval_pop hands out copies of them. every thread
+// has its own table, so the same value can be interned once per thread.
+POOL_LOCAL lval** intern_tab = NULL;
+POOL_LOCAL int intern_slots = 0;
+POOL_LOCAL int intern_count = 0;
+
+uint32_t hash_mix(uint32_t h, uint32_t x){
+  h ^= x;
+  h *= 0x01000193u;
+  return h ^ (h >> 15);
+}
+
+uint32_t hash_bits(uint32_t h, uint64_t x){
+  return hash_mix(hash_mix(h, (uint32_t)x), (uint32_t)(x >> 32));
+}
+
+uint32_t hash_str(uint32_t h, char* s){
+  while(*s) h = hash_mix(h, (unsigned char)*s++);
+  return h;
+}
+
+// hash over type and contents, equal under lval_eq -> equal hashes
+uint32_t lval_hash(lval* v){
+  if(v->interned) return v->hash;
+
+  uint32_t h = hash_mix(0x811c9dc5u, v->type);
+  uint64_t b;
+  switch(v->type){
+    case LVAL_NUM: memcpy(&b, &v->num, sizeof(b)); h = hash_bits(h, b); break;
+    case LVAL_INT: h = hash_bits(h, (uint64_t)v->inum); break;
+    case LVAL_ERR:
+      h = hash_mix(h, v->code);
+      if(v->sym) h = hash_str(h, v->sym);
+      break;
+    case LVAL_SYM: h = hash_str(h, v->sym); break;
+    case LVAL_VEC:
+      h = hash_mix(h, v->count);
+      for(int i = 0; i < v->count; i++){
+        memcpy(&b, &v->vec[i], sizeof(b));
+        h = hash_bits(h, b);
+      }
+      break;
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+      h = hash_mix(h, v->count);
+      for(int i = 0; i < v->count; i++) h = hash_mix(h, lval_hash(v->cell[i]));
+      break;
+  }
+  return h;
+}
+
+// structural equality, doubles compare by bits so -0 and 0 stay apart and nan matches itself
+int lval_eq(lval* a, lval* b){
+  if(a == b) return 1;
+  // interned values are unique only within the table of the thread that made them,
+  // so two of them are only known apart by their cached hashes
+  if(a->interned && b->interned && a->hash != b->hash) return 0;
+  if(a->type != b->type) return 0;
+
+  switch(a->type){
+    case LVAL_NUM: return memcmp(&a->num, &b->num, sizeof(double)) == 0;
+    case LVAL_INT: return a->inum == b->inum;
+    case LVAL_ERR:
+      if(a->code != b->code) return 0;
+      return a->sym == b->sym || (a->sym && b->sym && strcmp(a->sym, b->sym) == 0);
+    case LVAL_SYM: return strcmp(a->sym, b->sym) == 0;
+    case LVAL_VEC:
+      return a->count == b->count && memcmp(a->vec, b->vec, sizeof(double) * a->count) == 0;
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+      if(a->count != b->count) return 0;
+      for(int i = 0; i < a->count; i++) if(!lval_eq(a->cell[i], b->cell[i])) return 0;
+      return 1;
+  }
+  return 0;
+}
+
+// open addressing, kept at most half full
+void lval_intern_grow(void){
+  int slots = intern_slots ? intern_slots * 2 : 256;
+  lval** tab = calloc(slots, sizeof(lval*));
+  for(int i = 0; i < intern_slots; i++){
+    if(!intern_tab[i]) continue;
+    int j = intern_tab[i]->hash & (slots-1);
+    while(tab[j]) j = (j+1) & (slots-1);
+    tab[j] = intern_tab[i];
+  }
+  free(intern_tab);
+  intern_tab = tab;
+  intern_slots = slots;
+}
+
+// returns the shared copy of v, v itself is consumed. qexpr children must already be interned
+lval* lval_intern(lval* v){
+  if(intern_count * 2 >= intern_slots) lval_intern_grow();
+
+  uint32_t h = lval_hash(v);
+  int i = h & (intern_slots-1);
+  while(intern_tab[i]){
+    if(intern_tab[i]->hash == h && lval_eq(intern_tab[i], v)){
+      lval_del(v);
+      return intern_tab[i];
+    }
+    i = (i+1) & (intern_slots-1);
+  }
+
+  v->hash = h;
+  v->interned = 1;
+  intern_tab[i] = v;
+  intern_count++;
+  return v;
+}
+
+// interns every num and constant qexpr under v, bottom up
+lval* lval_intern_tree(lval* v){
+  switch(v->type){
+    case LVAL_NUM:
+    case LVAL_INT:
+      return lval_intern(v);
+    case LVAL_SEXPR:
+    case LVAL_QEXPR: {
+      int konst = 1;
+      for(int i = 0; i < v->count; i++){
+        v->cell[i] = lval_intern_tree(v->cell[i]);
+        konst = konst && v->cell[i]->interned;
+      }
+      return v->type == LVAL_QEXPR && konst ? lval_intern(v) : v;
+    }
+  }
+  return v;
+}
+
+// ----- builtin registry ----- //
+
+// name -> lbuiltin, open addressing over entries that never move, so
+// pointers to them (like the memo cache keeps) stay valid as it grows
+lbuiltin** builtin_tab = NULL;
+int builtin_slots = 0;
+int builtin_count = 0;
+
+lbuiltin* builtin_find(char* name){
+  if(!builtin_slots) return NULL;
+  int i = hash_str(0x811c9dc5u, name) & (builtin_slots-1);
+  while(builtin_tab[i]){
+    if(strcmp(builtin_tab[i]->name, name) == 0) return builtin_tab[i];
+    i = (i+1) & (builtin_slots-1);
+  }
+  return NULL;
+}
+
+void builtin_grow(void){
+  int slots = builtin_slots ? builtin_slots * 2 : 64;
+  lbuiltin** tab = calloc(slots, sizeof(lbuiltin*));
+  for(int i = 0; i < builtin_slots; i++){
+    if(!builtin_tab[i]) continue;
+    int j = hash_str(0x811c9dc5u, builtin_tab[i]->name) & (slots-1);
+    while(tab[j]) j = (j+1) & (slots-1);
+    tab[j] = builtin_tab[i];
+  }
+  free(builtin_tab);
+  builtin_tab = tab;
+  builtin_slots = slots;
+}
+
+// adds or replaces a builtin, returns 0 for names the grammar can't hold.
+// only builtins registered before builtin_grammar runs can be parsed
+int crno_register_builtin(char* name, lbuiltin_fn fn, int arity, int flags){
+  if(name[0] == '\0') return 0;
+  for(char* c = name; *c; c++) if(*c <= ' ' || *c == '"' || *c == '\\' || *c > '~') return 0;
+
+  lbuiltin* b = builtin_find(name);
+  if(!b){
+    if(builtin_count * 2 >= builtin_slots) builtin_grow();
+    b = calloc(1, sizeof(lbuiltin));
+    b->name = malloc(strlen(name)+1);
+    strcpy(b->name, name);
+
+    int i = hash_str(0x811c9dc5u, name) & (builtin_slots-1);
+    while(builtin_tab[i]) i = (i+1) & (builtin_slots-1);
+    builtin_tab[i] = b;
+    builtin_count++;
+  }
+  b->fn = fn;
+  b->arity = arity;
+  b->flags = flags;
+  return 1;
+}
+
+// eval isn't pure, its qexpr may call impure builtins, the calls inside get cached anyway.
+// only % and ^ are memoized, everything else is cheaper to run again than to look up
+void builtin_init(void){
+  crno_register_builtin("+", builtin_add, -1, BUILTIN_PURE);
+  crno_register_builtin("-", builtin_sub, -1, BUILTIN_PURE);
+  crno_register_builtin("*", builtin_mul, -1, BUILTIN_PURE);
+  crno_register_builtin("/", builtin_div, -1, BUILTIN_PURE);
+  crno_register_builtin("%", builtin_mod, -1, BUILTIN_PURE | BUILTIN_MEMO);
+  crno_register_builtin("^", builtin_pow, -1, BUILTIN_PURE | BUILTIN_MEMO);
+  crno_register_builtin("min", builtin_min, -1, BUILTIN_PURE);
+  crno_register_builtin("max", builtin_max, -1, BUILTIN_PURE);
+  crno_register_builtin("list", builtin_list, -1, BUILTIN_PURE);
+  crno_register_builtin("head", builtin_head, 1, BUILTIN_PURE);
+  crno_register_builtin("tail", builtin_tail, 1, BUILTIN_PURE);
+  crno_register_builtin("join", builtin_join, -1, BUILTIN_PURE);
+  crno_register_builtin("eval", builtin_eval, 1, 0);
+  crno_register_builtin("vec", builtin_vec, -1, BUILTIN_PURE);
+  crno_register_builtin("vadd", builtin_vadd, 2, BUILTIN_PURE);
+  crno_register_builtin("vmul", builtin_vmul, 2, BUILTIN_PURE);
+  crno_register_builtin("dot", builtin_dot, 2, BUILTIN_PURE);
+  crno_register_builtin("sum", builtin_sum, 1, BUILTIN_PURE);
+  crno_register_builtin("cache-stats", builtin_cache_stats, 0, 0);
+  crno_register_builtin("mem-stats", builtin_mem_stats, 0, 0);
+  crno_register_builtin("profile", builtin_profile, 1, 0);
+  crno_register_builtin("profile-report", builtin_profile_report, 0, 0);
+  crno_register_builtin("map", builtin_map, 2, 0);
+  crno_register_builtin("filter", builtin_filter, 2, 0);
+  crno_register_builtin("fold", builtin_fold, 3, 0);
+  crno_register_builtin("pmap", builtin_pmap, 2, 0);
+  crno_register_builtin("pfold", builtin_pfold, 3, 0);
+}
+
+// fmt with its %s replaced by every registered name as \"name\" | ...
+char* builtin_grammar(char* fmt){
+  size_t n = 1;
+  for(int i = 0; i < builtin_slots; i++) if(builtin_tab[i]) n += strlen(builtin_tab[i]->name) + 5;
+  char* syms = malloc(n);
+  char* p = syms;
+  *p = '\0';
+  for(int i = 0; i < builtin_slots; i++){
+    if(!builtin_tab[i]) continue;
+    p += sprintf(p, "%s\"%s\"", p == syms ? "" : " | ", builtin_tab[i]->name);
+  }
+
+  size_t len = strlen(fmt) + strlen(syms) + 1;
+  char* lang = malloc(len);
+  snprintf(lang, len, fmt, syms);
+  free(syms);
+  return lang;
+}
+
+// ----- memo cache ----- //
+
+// memo builtin calls keyed by (name, evaluated args), with results kept in
+// an lru list. entries are dropped from the cold end once their total size
+// passes cache_budget.
+typedef struct centry {
+  uint32_t hash;
+  lbuiltin* fn;
+  lval* args;
+  lval* res;
+  size_t bytes;
+  struct centry* chain; // next in the same bucket
+  struct centry* prev;  // lru list, head is the most recently used
+  struct centry* next;
+} centry;
+
+POOL_LOCAL centry** cache_tab = NULL;
+POOL_LOCAL int cache_slots = 0;
+POOL_LOCAL int cache_count = 0;
+POOL_LOCAL size_t cache_bytes = 0;
+POOL_LOCAL centry* cache_head = NULL;
+POOL_LOCAL centry* cache_tail = NULL;
+POOL_LOCAL long cache_hits = 0, cache_misses = 0, cache_evictions = 0;
+
+// bytes held by v, interned values belong to the intern table and count as 0
+size_t lval_size(lval* v){
+  if(v->interned) return 0;
+  size_t n = sizeof(lval);
+  switch(v->type){
+    case LVAL_SYM: n += strlen(v->sym)+1; break;
+    case LVAL_VEC: n += sizeof(double) * v->count; break;
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+      n += sizeof(lval*) * v->count;
+      for(int i = 0; i < v->count; i++) n += lval_size(v->cell[i]);
+      break;
+  }
+  return n;
+}
+
+// a copy that's safe to hold on to, interned values don't need one
+lval* lval_keep(lval* v){
+  if(!v->interned) return lval_copy(v);
+  mem_hit(MEM_LVAL);
+  return v;
+}
+
+void cache_unlink(centry* e){
+  if(e->prev) e->prev->next = e->next; else cache_head = e->next;
+  if(e->next) e->next->prev = e->prev; else cache_tail = e->prev;
+}
+
+void cache_push(centry* e){
+  e->prev = NULL;
+  e->next = cache_head;
+  if(cache_head) cache_head->prev = e; else cache_tail = e;
+  cache_head = e;
+}
+
+void cache_evict(void){
+  centry* e = cache_tail;
+  centry** p = &cache_tab[e->hash & (cache_slots-1)];
+  while(*p != e) p = &(*p)->chain;
+  *p = e->chain;
+
+  cache_unlink(e);
+  cache_bytes -= e->bytes;
+  cache_count--;
+  cache_evictions++;
+  lval_del(e->args);
+  lval_del(e->res);
+  free(e);
+}
+
+void cache_grow(void){
+  int slots = cache_slots ? cache_slots * 2 : 256;
+  centry** tab = calloc(slots, sizeof(centry*));
+  for(int i = 0; i < cache_slots; i++){
+    centry* e = cache_tab[i];
+    while(e){
+      centry* chain = e->chain;
+      e->chain = tab[e->hash & (slots-1)];
+      tab[e->hash & (slots-1)] = e;
+      e = chain;
+    }
+  }
+  free(cache_tab);
+  cache_tab = tab;
+  cache_slots = slots;
+}
+
+void cache_insert(uint32_t h, lbuiltin* b, lval* args, lval* res){
+  size_t bytes = sizeof(centry) + lval_size(args) + lval_size(res);
+  if(bytes > cache_budget){ lval_del(args); lval_del(res); return; }
+
+  while(cache_bytes + bytes > cache_budget) cache_evict();
+  if(cache_count >= cache_slots) cache_grow();
+
+  centry* e = malloc(sizeof(centry));
+  e->hash = h;
+  e->fn = b;
+  e->args = args;
+  e->res = res;
+  e->bytes = bytes;
+  e->chain = cache_tab[h & (cache_slots-1)];
+  cache_tab[h & (cache_slots-1)] = e;
+  cache_push(e);
+  cache_bytes += bytes;
+  cache_count++;
+}
+
+// only calls on plain numbers are looked up, list args cost a deep copy on
+// every miss and a walk on every compare
+int cache_scalars(lval* a){
+  for(int i = 0; i < a->count; i++)
+    if(a->cell[i]->type != LVAL_INT && a->cell[i]->type != LVAL_NUM) return 0;
+  return 1;
+}
+
+// b->fn with memoization, errors are never stored
+lval* builtin_cached(lval* a, lbuiltin* b){
+  uint32_t h = hash_str(lval_hash(a), b->name);
+  for(centry* e = cache_slots ? cache_tab[h & (cache_slots-1)] : NULL; e; e = e->chain){
+    if(e->hash != h || e->fn != b || !lval_eq(e->args, a)) continue;
+    cache_hits++;
+    cache_unlink(e);
+    cache_push(e);
+    lval_del(a);
+    return lval_keep(e->res);
+  }
+
+  cache_misses++;
+  lval* args = lval_keep(a);
+  lval* res = b->fn(a);
+  if(res->type == LVAL_ERR){ lval_del(args); return res; }
+  cache_insert(h, b, args, lval_keep(res));
+  return res;
+}
+
 // ----- builtin funcs impl -----
 
+char* lop_names[] = { "+", "-", "*", "/", "%", "^", "min", "max" };
+
+// maps an operator sym to its enum, resolved once per call instead of per operand
+int lval_op(char* s){
+  if(strcmp(s, "min") == 0) return LOP_MIN;
+  if(strcmp(s, "max") == 0) return LOP_MAX;
+  if(s[0] == '\0' || s[1] != '\0') return LOP_NONE;
+  switch(s[0]){
+    case '+': return LOP_ADD;
+    case '-': return LOP_SUB;
+    case '*': return LOP_MUL;
+    case '/': return LOP_DIV;
+    case '%': return LOP_MOD;
+    case '^': return LOP_POW;
+  }
+  return LOP_NONE;
+}
+
 lval* builtin(lval* a, char* func){
-  if(strcmp("list", func) == 0) return builtin_list(a);
-  if(strcmp("head", func) == 0) return builtin_head(a);
-  if(strcmp("tail", func) == 0) return builtin_tail(a);
-  if(strcmp("join", func) == 0) return builtin_join(a);
-  if(strcmp("eval", func) == 0) return builtin_eval(a);
+  lbuiltin* b = builtin_find(func);
+  if(!b){
+    lval_del(a);
+    return lval_err(LERR_BAD_OP, NULL);
+  }
 
-  if(strstr("+-/*%^", func)) return builtin_op(a, func);
+  if(b->arity >= 0 && a->count != b->arity){
+    int code = a->count > b->arity ? LERR_TOO_MANY : LERR_TOO_FEW;
+    lval_del(a);
+    return lval_err(code, b->name);
+  }
 
-  lval_del(a);
-  return lval_err("baka! unknown fun");
+  if(__atomic_load_n(&prof_on, __ATOMIC_RELAXED)) return builtin_profiled(a, b);
+  return builtin_call(a, b);
+}
+
+// b->fn, through the memo cache when it's worth it
+lval* builtin_call(lval* a, lbuiltin* b){
+  if(cache_on && (b->flags & BUILTIN_MEMO) && cache_scalars(a)) return builtin_cached(a, b);
+  return b->fn(a);
 }
 
-lval* builtin_op(lval* a, char* op){
+// builtins called as (f), any other single sym just evaluates to itself
+int builtin_nullary(char* func){
+  lbuiltin* b = builtin_find(func);
+  return b && b->arity == 0;
+}
+
+lval* builtin_add(lval* a){ return builtin_op(a, LOP_ADD); }
+lval* builtin_sub(lval* a){ return builtin_op(a, LOP_SUB); }
+lval* builtin_mul(lval* a){ return builtin_op(a, LOP_MUL); }
+lval* builtin_div(lval* a){ return builtin_op(a, LOP_DIV); }
+lval* builtin_mod(lval* a){ return builtin_op(a, LOP_MOD); }
+lval* builtin_pow(lval* a){ return builtin_op(a, LOP_POW); }
+lval* builtin_min(lval* a){ return builtin_op(a, LOP_MIN); }
+lval* builtin_max(lval* a){ return builtin_op(a, LOP_MAX); }
+
+lval* builtin_op(lval* a, int op){
   // ensure all args are nums
+  int ints = 0;
   for(int i = 0; i < a->count; i++){
+    if(a->cell[i]->type == LVAL_INT){ ints++; continue; }
     if(a->cell[i]->type != LVAL_NUM){
       lval_del(a);
-      return lval_err("baka! non-number");
+      return lval_err(LERR_NOT_NUM, lop_names[op]);
     }
   }
 
-  lval* x = lval_pop(a, 0);
+  // all ints stay exact, any double turns the whole op into float
+  if(ints == a->count) return builtin_op_int(a, op);
+  for(int i = 0; ints && i < a->count; i++){
+    if(a->cell[i]->type != LVAL_INT) continue;
+    a->cell[i] = lval_own(a->cell[i]);
+    a->cell[i]->num = (double)a->cell[i]->inum;
+    a->cell[i]->type = LVAL_NUM;
+  }
+
+  lval** c = a->cell;
+  int n = a->count;
+  double x = c[0]->num;
 
   // no args && sub -> unary negation
-  if((strcmp(op, "-") == 0) && a->count == 0) x->num = -x->num;
-
-  while(a->count > 0){
-    lval* y = lval_pop(a, 0);
-
-    if(strcmp(op, "+") == 0) x->num += y->num;
-    if(strcmp(op, "-") == 0) x->num -= y->num;
-    if(strcmp(op, "*") == 0) x->num *= y->num;
-    if(strcmp(op, "^") == 0) x->num = pow(x->num, y->num);
-    if(strcmp(op, "%") == 0) x->num = (int)x->num % (int)y->num;
-    if(strcmp(op, "/") == 0){
-      if(y->num == 0){
-        lval_del(x); lval_del(y);
-        x = lval_err("baka! division by zero");
+  if(op == LOP_SUB && n == 1) x = -x;
+
+  // 2 args fast path, the most common shape by far
+  else if(n == 2){
+    double y = c[1]->num;
+    switch(op){
+      case LOP_ADD: x += y; break;
+      case LOP_SUB: x -= y; break;
+      case LOP_MUL: x *= y; break;
+      case LOP_POW: x = pow(x, y); break;
+      case LOP_MIN: x = y < x ? y : x; break;
+      case LOP_MAX: x = y > x ? y : x; break;
+      // 0 and -0 alike, the same error the int path gives
+      case LOP_DIV:
+      case LOP_MOD:
+        if(y == 0){ lval_del(a); return lval_err(LERR_DIV_ZERO, NULL); }
+        x = op == LOP_DIV ? x / y : fmod(x, y);
         break;
-      }
-      x->num /= y->num;
     }
-    lval_del(y);
   }
-  lval_del(a);
+
+  // wide reductions go through the simd kernels unless strict ordering was asked for
+  else if(!simd_strict && n > REDUCE_MIN && op != LOP_SUB && op != LOP_DIV
+          && op != LOP_MOD && op != LOP_POW){
+    x = lval_reduce(c, n, op);
+  }
+
+  // one tight loop per op over the cell array, no pops
+  else{
+    switch(op){
+      case LOP_ADD: for(int i = 1; i < n; i++) x += c[i]->num; break;
+      case LOP_SUB: for(int i = 1; i < n; i++) x -= c[i]->num; break;
+      case LOP_MUL: for(int i = 1; i < n; i++) x *= c[i]->num; break;
+      case LOP_POW: for(int i = 1; i < n; i++) x = pow(x, c[i]->num); break;
+      case LOP_MIN: for(int i = 1; i < n; i++) x = c[i]->num < x ? c[i]->num : x; break;
+      case LOP_MAX: for(int i = 1; i < n; i++) x = c[i]->num > x ? c[i]->num : x; break;
+      case LOP_DIV:
+      case LOP_MOD:
+        for(int i = 1; i < n; i++){
+          if(c[i]->num == 0){ lval_del(a); return lval_err(LERR_DIV_ZERO, NULL); }
+          x = op == LOP_DIV ? x / c[i]->num : fmod(x, c[i]->num);
+        }
+        break;
+    }
+  }
+
+  // reuse the first operand as the result
+  lval* res = lval_take(a, 0);
+  res->num = x;
+  return res;
+}
+
+// exact int64 reduction, falls over to builtin_op's float path on overflow
+lval* builtin_op_int(lval* a, int op){
+  lval** c = a->cell;
+  int n = a->count;
+  int64_t x = c[0]->inum, r = x;
+
+  // no args && sub -> unary negation, -INT64_MIN doesn't fit
+  if(op == LOP_SUB && n == 1){
+    if(x == INT64_MIN){ lval_del(a); return lval_num(-(double)INT64_MIN); }
+    x = -x;
+  }
+
+  for(int i = 1; i < n; i++){
+    int64_t y = c[i]->inum;
+    int ovf = 0;
+    switch(op){
+      case LOP_ADD: ovf = __builtin_add_overflow(x, y, &r); break;
+      case LOP_SUB: ovf = __builtin_sub_overflow(x, y, &r); break;
+      case LOP_MUL: ovf = __builtin_mul_overflow(x, y, &r); break;
+      case LOP_POW: ovf = lval_ipow(x, y, &r); break;
+      case LOP_MIN: r = y < x ? y : x; break;
+      case LOP_MAX: r = y > x ? y : x; break;
+      case LOP_MOD:
+        if(y == 0){ lval_del(a); return lval_err(LERR_DIV_ZERO, NULL); }
+        r = y == -1 ? 0 : x % y; // INT64_MIN % -1 traps on x86
+        break;
+      case LOP_DIV:
+        if(y == 0){ lval_del(a); return lval_err(LERR_DIV_ZERO, NULL); }
+        // only exact quotients stay ints, (/ 7 2) is still 3.5
+        ovf = (y == -1 && x == INT64_MIN) || x % y != 0;
+        if(!ovf) r = x / y;
+        break;
+    }
+    if(ovf) return builtin_op_promote(a, op, i, (double)x);
+    x = r;
+  }
+
+  lval* res = lval_take(a, 0);
+  res->inum = x;
+  return res;
+}
+
+// cells [0, i) were folded into x, finish the rest of the reduction as doubles
+lval* builtin_op_promote(lval* a, int op, int i, double x){
+  for(int j = 0; j < i-1; j++) lval_del(a->cell[j]);
+  memmove(a->cell, a->cell + i-1, sizeof(lval*) * (a->count - i + 1));
+  a->count -= i-1;
+
+  // a double first cell makes builtin_op convert the remaining ints
+  a->cell[0] = lval_own(a->cell[0]);
+  a->cell[0]->type = LVAL_NUM;
+  a->cell[0]->num = x;
+  return builtin_op(a, op);
+}
+
+// x^y by squaring, non-zero when it doesn't fit an int64 (or y < 0)
+int lval_ipow(int64_t x, int64_t y, int64_t* res){
+  int64_t r = 1;
+  if(y < 0) return 1;
+  while(y){
+    if((y & 1) && __builtin_mul_overflow(r, x, &r)) return 1;
+    y >>= 1;
+    if(y && __builtin_mul_overflow(x, x, &x)) return 1;
+  }
+  *res = r;
+  return 0;
+}
+
+// gathers nums into a stack buffer chunk by chunk and reduces each with simd
+double lval_reduce(lval** c, int n, int op){
+  int kind = op == LOP_ADD ? SIMD_ADD
+           : op == LOP_MUL ? SIMD_MUL
+           : op == LOP_MIN ? SIMD_MIN : SIMD_MAX;
+  double buf[REDUCE_CHUNK];
+  double x = c[0]->num;
+
+  for(int i = 1; i < n; i += REDUCE_CHUNK){
+    int m = n - i < REDUCE_CHUNK ? n - i : REDUCE_CHUNK;
+    for(int j = 0; j < m; j++) buf[j] = c[i+j]->num;
+    x = simd_reduce(kind, x, buf, m);
+  }
   return x;
 }
 
 lval* builtin_head(lval* a){
-  LASSERT(a, a->count == 1, "baka! 'head' fun passed too many args!");
-  LASSERT(a, a->cell[0]->type == LVAL_QEXPR, "baka! 'head' fun passed incorrect type!");
-  LASSERT(a, a->cell[0]->count != 0, "baka! 'head' fun passed {}!");
+  LASSERT(a, a->cell[0]->type == LVAL_QEXPR || a->cell[0]->type == LVAL_VEC, LERR_BAD_TYPE, "head");
+  LASSERT(a, a->cell[0]->count != 0, LERR_EMPTY, "head");
 
   lval* v = lval_take(a, 0);
+  if(v->type == LVAL_VEC){
+    lval_charge(-(long)sizeof(double) * (v->count - 1));
+    v->count = 1;
+    v->vec = lval_vec_buf(v->vec, 1);
+    return v;
+  }
+
   while(v->count > 1) lval_del(lval_pop(v, 1));
 
   return v;
 }
 
 lval* builtin_tail(lval* a){
-  LASSERT(a, a->count == 1, "baka! 'tail' fun passed too many args!");
-  LASSERT(a, a->cell[0]->type == LVAL_QEXPR, "baka! 'tail' fun passed incorrect type!");
-  LASSERT(a, a->cell[0]->count != 0, "baka! 'tail' fun passed {}!");
+  LASSERT(a, a->cell[0]->type == LVAL_QEXPR || a->cell[0]->type == LVAL_VEC, LERR_BAD_TYPE, "tail");
+  LASSERT(a, a->cell[0]->count != 0, LERR_EMPTY, "tail");
 
   lval* v = lval_take(a, 0);
+  if(v->type == LVAL_VEC){
+    lval_charge(-(long)sizeof(double));
+    v->count--;
+    memmove(v->vec, v->vec + 1, sizeof(double) * v->count);
+    return v;
+  }
+
   lval_del(lval_pop(v, 0));
   return v;
 }
@@ -404,8 +2371,7 @@ lval* builtin_list(lval* a){
 }
 
 lval* builtin_eval(lval* a){
-  LASSERT(a, a->count == 1, "baka! 'eval' fun passed too many args!");
-  LASSERT(a, a->cell[0]->type == LVAL_QEXPR, "baka! 'eval' fun passed incorrect type!");
+  LASSERT(a, a->cell[0]->type == LVAL_QEXPR, LERR_BAD_TYPE, "eval");
 
   lval* x = lval_take(a, 0);
   x->type = LVAL_SEXPR;
@@ -413,7 +2379,21 @@ lval* builtin_eval(lval* a){
 }
 
 lval* builtin_join(lval* a){
-  for(int i = 0; i < a->count; i++) LASSERT(a, a->cell[i]->type == LVAL_QEXPR, "baka! 'join' fun passed incorrect type!");
+  int vecs = 0;
+  for(int i = 0; i < a->count; i++){
+    LASSERT(a, a->cell[i]->type == LVAL_QEXPR || a->cell[i]->type == LVAL_VEC, LERR_BAD_TYPE, "join");
+    if(a->cell[i]->type == LVAL_VEC) vecs++;
+  }
+
+  // all vecs stay packed, mixed with qexprs they get unpacked into nums
+  if(vecs == a->count){
+    lval* x = lval_pop(a, 0);
+    while(a->count) x = lval_vec_join(x, lval_pop(a, 0));
+    lval_del(a);
+    return x;
+  }
+  for(int i = 0; vecs && i < a->count; i++)
+    if(a->cell[i]->type == LVAL_VEC) a->cell[i] = lval_vec_unpack(a->cell[i]);
 
   lval* x = lval_pop(a, 0);
   while(a->count) x = lval_join(x, lval_pop(a, 0));
@@ -422,6 +2402,412 @@ lval* builtin_join(lval* a){
   return x;
 }
 
+// packs nums, or a single qexpr of nums, into one contiguous vec
+lval* builtin_vec(lval* a){
+  if(a->count == 1 && a->cell[0]->type == LVAL_QEXPR) a = lval_take(a, 0);
+  for(int i = 0; i < a->count; i++) LASSERT(a, a->cell[i]->type == LVAL_NUM || a->cell[i]->type == LVAL_INT, LERR_NOT_NUM, "vec");
+
+  lval* v = lval_vec(a->count);
+  for(int i = 0; i < a->count; i++) v->vec[i] = lval_as_num(a->cell[i]);
+
+  lval_del(a);
+  return v;
+}
+
+// element-wise vec op vec, or vec op num broadcast, written into the first vec
+lval* builtin_vmap(lval* a, int op){
+  char* name = op == SIMD_ADD ? "vadd" : "vmul";
+  LASSERT(a, a->cell[0]->type == LVAL_VEC, LERR_BAD_TYPE, name);
+  LASSERT(a, a->cell[1]->type == LVAL_VEC || a->cell[1]->type == LVAL_NUM || a->cell[1]->type == LVAL_INT, LERR_BAD_TYPE, name);
+
+  lval* x = a->cell[0];
+  lval* y = a->cell[1];
+  if(y->type == LVAL_VEC){
+    LASSERT(a, x->count == y->count, LERR_VEC_LEN, name);
+    simd_map(op, x->vec, x->vec, y->vec, x->count);
+  }else{
+    double k = lval_as_num(y);
+    if(op == SIMD_ADD) for(int i = 0; i < x->count; i++) x->vec[i] += k;
+    else for(int i = 0; i < x->count; i++) x->vec[i] *= k;
+  }
+
+  return lval_take(a, 0);
+}
+
+lval* builtin_vadd(lval* a){ return builtin_vmap(a, SIMD_ADD); }
+lval* builtin_vmul(lval* a){ return builtin_vmap(a, SIMD_MUL); }
+
+lval* builtin_dot(lval* a){
+  LASSERT(a, a->cell[0]->type == LVAL_VEC && a->cell[1]->type == LVAL_VEC, LERR_BAD_TYPE, "dot");
+  LASSERT(a, a->cell[0]->count == a->cell[1]->count, LERR_VEC_LEN, "dot");
+
+  double x = simd_dot(a->cell[0]->vec, a->cell[1]->vec, a->cell[0]->count);
+  lval_del(a);
+  return lval_num(x);
+}
+
+lval* builtin_sum(lval* a){
+  LASSERT(a, a->cell[0]->type == LVAL_VEC, LERR_BAD_TYPE, "sum");
+
+  double x = simd_reduce(SIMD_ADD, 0, a->cell[0]->vec, a->cell[0]->count);
+  lval_del(a);
+  return lval_num(x);
+}
+
+// {hits misses evictions entries bytes}
+lval* builtin_cache_stats(lval* a){
+  lval_del(a);
+
+  lval* x = lval_qexpr();
+  x = lval_add(x, lval_int(cache_hits));
+  x = lval_add(x, lval_int(cache_misses));
+  x = lval_add(x, lval_int(cache_evictions));
+  x = lval_add(x, lval_int(cache_count));
+  x = lval_add(x, lval_int(cache_bytes));
+  return x;
+}
+
+// {{kind allocs frees bytes hits live peak} ...} for lval, ast, parse and err, all 0 without --mem-stats
+lval* builtin_mem_stats(lval* a){
+  lval_del(a);
+
+  lval* x = lval_qexpr();
+  for(int k = 0; k < MEM_KINDS; k++){
+    mem_stats s = mem_get(k);
+    lval* row = lval_qexpr();
+    row = lval_add(row, lval_sym((char*)mem_kind_names[k]));
+    row = lval_add(row, lval_int(s.allocs));
+    row = lval_add(row, lval_int(s.frees));
+    row = lval_add(row, lval_int(s.bytes));
+    row = lval_add(row, lval_int(s.hits));
+    row = lval_add(row, lval_int(s.live));
+    row = lval_add(row, lval_int(s.peak));
+    x = lval_add(x, row);
+  }
+  return x;
+}
+
+// ----- profiler ----- //
+
+// nesting of profiled calls on this thread, and what the calls nested in the
+// current one took, so it can leave them out of its exclusive numbers
+POOL_LOCAL int prof_depth = 0;
+POOL_LOCAL int64_t prof_child_ns = 0;
+POOL_LOCAL int64_t prof_child_bytes = 0;
+
+lval* builtin_profiled(lval* a, lbuiltin* b){
+  prof_stat* s = &b->prof[prof_depth < PROF_DEPTHS ? prof_depth : PROF_DEPTHS-1];
+  int64_t child_ns = prof_child_ns, child_bytes = prof_child_bytes;
+  prof_child_ns = prof_child_bytes = 0;
+  prof_depth++;
+
+  int64_t bytes = prof_bytes;
+  int64_t t = now_ns();
+  lval* res = builtin_call(a, b);
+  int64_t ns = now_ns() - t;
+  bytes = prof_bytes - bytes;
+
+  __atomic_add_fetch(&s->calls, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&s->incl_ns, ns, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&s->excl_ns, ns - prof_child_ns, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&s->bytes, bytes - prof_child_bytes, __ATOMIC_RELAXED);
+
+  prof_depth--;
+  prof_child_ns = child_ns + ns;
+  prof_child_bytes = child_bytes + bytes;
+  return res;
+}
+
+void profile_reset(void){
+  for(int i = 0; i < builtin_slots; i++){
+    if(!builtin_tab[i]) continue;
+    for(int d = 0; d < PROF_DEPTHS; d++){
+      prof_stat* s = &builtin_tab[i]->prof[d];
+      __atomic_store_n(&s->calls, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&s->incl_ns, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&s->excl_ns, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&s->bytes, 0, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// every depth of b added up
+prof_stat profile_total(lbuiltin* b){
+  prof_stat t = { 0, 0, 0, 0 };
+  for(int d = 0; d < PROF_DEPTHS; d++){
+    t.calls += __atomic_load_n(&b->prof[d].calls, __ATOMIC_RELAXED);
+    t.incl_ns += __atomic_load_n(&b->prof[d].incl_ns, __ATOMIC_RELAXED);
+    t.excl_ns += __atomic_load_n(&b->prof[d].excl_ns, __ATOMIC_RELAXED);
+    t.bytes += __atomic_load_n(&b->prof[d].bytes, __ATOMIC_RELAXED);
+  }
+  return t;
+}
+
+int profile_cmp(const void* x, const void* y){
+  int64_t a = profile_total(*(lbuiltin**)x).excl_ns, b = profile_total(*(lbuiltin**)y).excl_ns;
+  return (a < b) - (a > b);
+}
+
+// builtins that were called, most exclusive time first. the caller frees the array
+lbuiltin** profile_sorted(int* n){
+  lbuiltin** bs = malloc(sizeof(lbuiltin*) * (builtin_count ? builtin_count : 1));
+  *n = 0;
+  for(int i = 0; i < builtin_slots; i++)
+    if(builtin_tab[i] && profile_total(builtin_tab[i]).calls) bs[(*n)++] = builtin_tab[i];
+  qsort(bs, *n, sizeof(lbuiltin*), profile_cmp);
+  return bs;
+}
+
+// the report as a table on stderr, with a line per call depth under builtins
+// called from more than one
+void profile_print(void){
+  int n;
+  lbuiltin** bs = profile_sorted(&n);
+  fflush(stdout);
+  fprintf(stderr, "%-16s %10s %12s %12s %12s\n", "builtin", "calls", "incl ms", "excl ms", "bytes");
+  for(int i = 0; i < n; i++){
+    prof_stat t = profile_total(bs[i]);
+    fprintf(stderr, "%-16s %10" PRId64 " %12.3f %12.3f %12" PRId64 "\n",
+            bs[i]->name, t.calls, t.incl_ns / 1e6, t.excl_ns / 1e6, t.bytes);
+
+    int depths = 0;
+    for(int d = 0; d < PROF_DEPTHS; d++) depths += bs[i]->prof[d].calls != 0;
+    if(depths < 2) continue;
+    for(int d = 0; d < PROF_DEPTHS; d++){
+      prof_stat* s = &bs[i]->prof[d];
+      if(!s->calls) continue;
+      fprintf(stderr, "  depth %2d%s      %10" PRId64 " %12.3f %12.3f %12" PRId64 "\n",
+              d, d == PROF_DEPTHS-1 ? "+" : " ", s->calls, s->incl_ns / 1e6, s->excl_ns / 1e6, s->bytes);
+    }
+  }
+  free(bs);
+}
+
+// (profile 1) starts profiling from zero, (profile 0) stops it. returns whether it was on
+lval* builtin_profile(lval* a){
+  LASSERT(a, a->cell[0]->type == LVAL_INT || a->cell[0]->type == LVAL_NUM, LERR_NOT_NUM, "profile");
+  int on = lval_truthy(a->cell[0]);
+  lval_del(a);
+  if(on) profile_reset();
+  return lval_int(__atomic_exchange_n(&prof_on, on, __ATOMIC_RELAXED));
+}
+
+// {{name calls incl_ns excl_ns bytes} ...}, most exclusive time first
+lval* builtin_profile_report(lval* a){
+  lval_del(a);
+  int n;
+  lbuiltin** bs = profile_sorted(&n);
+  lval* x = lval_qexpr();
+  for(int i = 0; i < n; i++){
+    prof_stat t = profile_total(bs[i]);
+    lval* row = lval_qexpr();
+    row = lval_add(row, lval_sym(bs[i]->name));
+    row = lval_add(row, lval_int(t.calls));
+    row = lval_add(row, lval_int(t.incl_ns));
+    row = lval_add(row, lval_int(t.excl_ns));
+    row = lval_add(row, lval_int(t.bytes));
+    x = lval_add(x, row);
+  }
+  free(bs);
+  return x;
+}
+
+// what map, filter and fold take as a function: a sym, or a qexpr like
+// {- 1} whose head is a sym and whose tail are extra args
+int lval_is_fn(lval* f){
+  if(f->type == LVAL_SYM) return 1;
+  return f->type == LVAL_QEXPR && f->count > 0 && f->cell[0]->type == LVAL_SYM;
+}
+
+// filter keeps elements whose result isn't zero
+int lval_truthy(lval* v){
+  return v->type == LVAL_INT ? v->inum != 0 : v->num != 0;
+}
+
+// evaluates (f x y args...), y can be NULL. x and y are consumed, f is only read
+lval* lval_apply(lval* f, lval* x, lval* y){
+  int extra = f->type == LVAL_QEXPR ? f->count-1 : 0;
+  lval* s = lval_sexpr();
+  s->count = 2 + (y != NULL) + extra;
+  s->cell = lval_cells(NULL, s->count);
+
+  int i = 0;
+  s->cell[i++] = lval_keep(f->type == LVAL_QEXPR ? f->cell[0] : f);
+  s->cell[i++] = x;
+  if(y) s->cell[i++] = y;
+  for(int j = 1; j <= extra; j++) s->cell[i++] = lval_keep(f->cell[j]);
+  return lval_eval(s);
+}
+
+// replaces xs[lo..hi) with (f x) in place, the first error is returned, NULL if none
+lval* lval_map_range(lval* f, lval* xs, int lo, int hi){
+  for(int i = lo; i < hi; i++){
+    xs->cell[i] = lval_apply(f, xs->cell[i], NULL);
+    if(xs->cell[i]->type == LVAL_ERR) return xs->cell[i];
+  }
+  return NULL;
+}
+
+// folds xs[lo..hi) into acc, the cells are consumed whether it gets there or not
+lval* lval_fold_range(lval* f, lval* acc, lval* xs, int lo, int hi){
+  for(int i = lo; i < hi; i++){
+    if(acc->type == LVAL_ERR){
+      for(; i < hi; i++) lval_del(xs->cell[i]);
+      break;
+    }
+    acc = lval_apply(f, acc, xs->cell[i]);
+  }
+  return acc;
+}
+
+// (map f {xs}), the list is reused for the results
+lval* builtin_map(lval* a){
+  LASSERT(a, lval_is_fn(a->cell[0]), LERR_BAD_TYPE, "map");
+  LASSERT(a, a->cell[1]->type == LVAL_QEXPR || a->cell[1]->type == LVAL_VEC, LERR_BAD_TYPE, "map");
+
+  lval* f = lval_pop(a, 0);
+  lval* xs = lval_take(a, 0);
+  if(xs->type == LVAL_VEC) xs = lval_vec_unpack(xs);
+
+  lval* err = lval_map_range(f, xs, 0, xs->count);
+  lval_del(f);
+  if(err){
+    lval_del(xs);
+    return err;
+  }
+  return xs;
+}
+
+// (filter f {xs}), keeps x where (f x) is non-zero, compacted in place
+lval* builtin_filter(lval* a){
+  LASSERT(a, lval_is_fn(a->cell[0]), LERR_BAD_TYPE, "filter");
+  LASSERT(a, a->cell[1]->type == LVAL_QEXPR || a->cell[1]->type == LVAL_VEC, LERR_BAD_TYPE, "filter");
+
+  lval* f = lval_pop(a, 0);
+  lval* xs = lval_take(a, 0);
+  if(xs->type == LVAL_VEC) xs = lval_vec_unpack(xs);
+
+  // f gets a copy, x stays in the list until it's known whether it's kept
+  int n = 0, i = 0;
+  lval* err = NULL;
+  for(; i < xs->count; i++){
+    lval* r = lval_apply(f, lval_keep(xs->cell[i]), NULL);
+    if(r->type == LVAL_ERR){
+      err = r;
+      break;
+    }
+    if(r->type != LVAL_NUM && r->type != LVAL_INT){
+      lval_del(r);
+      err = lval_err(LERR_NOT_NUM, "filter");
+      break;
+    }
+    if(lval_truthy(r)) xs->cell[n++] = xs->cell[i];
+    else lval_del(xs->cell[i]);
+    lval_del(r);
+  }
+  lval_del(f);
+
+  // on an error, cells from i on were never looked at
+  if(err) for(; i < xs->count; i++) lval_del(xs->cell[i]);
+  xs->count = n;
+  if(err){
+    lval_del(xs);
+    return err;
+  }
+  return xs;
+}
+
+// (fold f init {xs}), left to right: (f (f init x0) x1)...
+lval* builtin_fold(lval* a){
+  LASSERT(a, lval_is_fn(a->cell[0]), LERR_BAD_TYPE, "fold");
+  LASSERT(a, a->cell[2]->type == LVAL_QEXPR || a->cell[2]->type == LVAL_VEC, LERR_BAD_TYPE, "fold");
+
+  lval* f = lval_pop(a, 0);
+  lval* acc = lval_pop(a, 0);
+  lval* xs = lval_take(a, 0);
+  if(xs->type == LVAL_VEC) xs = lval_vec_unpack(xs);
+
+  acc = lval_fold_range(f, acc, xs, 0, xs->count);
+  xs->count = 0;
+  lval_del(xs);
+  lval_del(f);
+  return acc;
+}
+
+typedef struct pmap_job {
+  lval* f;
+  lval* xs;
+  lval** res;
+  int fold;
+  eval_limits* limits;
+} pmap_job;
+
+// one chunk of a pmap or pfold, chunks only touch their own cells
+void builtin_pmap_task(void* ctx, int k){
+  pmap_job* j = ctx;
+  int lo = k * PMAP_CHUNK;
+  int hi = lo + PMAP_CHUNK < j->xs->count ? lo + PMAP_CHUNK : j->xs->count;
+  eval_limits* outer = limits;
+  limits = j->limits;
+  if(j->fold) j->res[k] = lval_fold_range(j->f, j->xs->cell[lo], j->xs, lo+1, hi);
+  else j->res[k] = lval_map_range(j->f, j->xs, lo, hi);
+  limits = outer;
+}
+
+// map with the list split into chunks that run on the pool, same result as map
+lval* builtin_pmap(lval* a){
+  LASSERT(a, lval_is_fn(a->cell[0]), LERR_BAD_TYPE, "pmap");
+  LASSERT(a, a->cell[1]->type == LVAL_QEXPR || a->cell[1]->type == LVAL_VEC, LERR_BAD_TYPE, "pmap");
+
+  lval* f = lval_pop(a, 0);
+  lval* xs = lval_take(a, 0);
+  if(xs->type == LVAL_VEC) xs = lval_vec_unpack(xs);
+
+  int chunks = (xs->count + PMAP_CHUNK-1) / PMAP_CHUNK;
+  pmap_job job = { f, xs, calloc(chunks ? chunks : 1, sizeof(lval*)), 0, limits };
+  pool_for(chunks, builtin_pmap_task, NULL, &job);
+
+  // the first error in list order, whichever chunk finished first
+  lval* err = NULL;
+  for(int k = 0; k < chunks && !err; k++) err = job.res[k];
+  free(job.res);
+  lval_del(f);
+  if(err){
+    lval_del(xs);
+    return err;
+  }
+  return xs;
+}
+
+// fold with every chunk folded on the pool starting from its first element,
+// then the chunk results folded into init in order. the chunks don't depend
+// on the thread count, and for an associative f it's the same as fold
+lval* builtin_pfold(lval* a){
+  LASSERT(a, lval_is_fn(a->cell[0]), LERR_BAD_TYPE, "pfold");
+  LASSERT(a, a->cell[2]->type == LVAL_QEXPR || a->cell[2]->type == LVAL_VEC, LERR_BAD_TYPE, "pfold");
+
+  lval* f = lval_pop(a, 0);
+  lval* acc = lval_pop(a, 0);
+  lval* xs = lval_take(a, 0);
+  if(xs->type == LVAL_VEC) xs = lval_vec_unpack(xs);
+
+  int chunks = (xs->count + PMAP_CHUNK-1) / PMAP_CHUNK;
+  pmap_job job = { f, xs, lval_cells(NULL, chunks ? chunks : 1), 1, limits };
+  pool_for(chunks, builtin_pmap_task, NULL, &job);
+  xs->count = 0;
+  lval_del(xs);
+
+  // the results are a list of their own now, folded like any other
+  lval* rs = lval_qexpr();
+  rs->count = chunks;
+  rs->cell = job.res;
+  acc = lval_fold_range(f, acc, rs, 0, chunks);
+  rs->count = 0;
+  lval_del(rs);
+  lval_del(f);
+  return acc;
+}
+
 /*
 
 // evaluates number operations parsed by the eval function
@@ -0,0 +1,268 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+#ifdef _WIN32
+
+// no pthreads here, everything runs on the caller in order
+int pool_start(int n){ (void)n; return 1; }
+void pool_stop(void){}
+int pool_size(void){ return 1; }
+int pool_cpus(void){ return 1; }
+int pool_self(void){ return 0; }
+
+void pool_for(int n, pool_fn run, pool_fn done, void* ctx){
+  for(int i = 0; i < n; i++){
+    run(ctx, i);
+    if(done) done(ctx, i);
+  }
+}
+
+void pool_submit(pool_fn run, void* ctx, int i){ run(ctx, i); }
+
+#else
+
+#include <pthread.h>
+#include <unistd.h>
+
+// one pool_for or pool_submit call, tasks point back at it
+typedef struct pool_job {
+  pool_fn run;
+  pool_fn done;
+  void* ctx;
+  int n;
+  int left;       // tasks not finished yet, under lock
+  int next;       // next index to hand to done
+  char* finished;
+  int detached;   // from pool_submit, nobody waits on it so its task frees it
+  pthread_mutex_t lock;
+  pthread_cond_t idle; // signalled when left gets to 0
+} pool_job;
+
+typedef struct pool_task {
+  pool_job* job;
+  int i;
+} pool_task;
+
+// live tasks are tasks[top..bottom), the owner works at the bottom, thieves at the top
+typedef struct pool_deque {
+  pthread_mutex_t lock;
+  pool_task* tasks;
+  int top;
+  int bottom;
+  int cap;
+} pool_deque;
+
+static pool_deque* pool_deques = NULL;
+static pthread_t* pool_tids = NULL;
+static int pool_threads = 1;
+static int pool_quit = 0;
+static int pool_pending = 0; // queued in any deque, atomic
+static pthread_mutex_t pool_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;
+static POOL_LOCAL int pool_id = 0;
+
+static void pool_push(pool_deque* d, pool_task t){
+  if(d->bottom == d->cap){
+    if(d->top > 0){
+      memmove(d->tasks, d->tasks + d->top, sizeof(pool_task) * (d->bottom - d->top));
+      d->bottom -= d->top;
+      d->top = 0;
+    }else{
+      d->cap = d->cap ? d->cap * 2 : 64;
+      d->tasks = realloc(d->tasks, sizeof(pool_task) * d->cap);
+    }
+  }
+  d->tasks[d->bottom++] = t;
+}
+
+// own deque first, newest task, then the oldest task of every other thread in turn
+static int pool_take(pool_task* t){
+  for(int k = 0; k < pool_threads; k++){
+    pool_deque* d = &pool_deques[(pool_id + k) % pool_threads];
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if(d->top < d->bottom){
+      *t = k == 0 ? d->tasks[--d->bottom] : d->tasks[d->top++];
+      if(d->top == d->bottom) d->top = d->bottom = 0;
+      found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    if(found){
+      __atomic_sub_fetch(&pool_pending, 1, __ATOMIC_ACQ_REL);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// the newest task on the caller's deque, if it's one of job's. a pool_for only
+// queues on its caller's deque and thieves run what they take, so while any of
+// job is still queued it's at the bottom here
+static int pool_take_own(pool_job* job, pool_task* t){
+  pool_deque* d = &pool_deques[pool_id];
+  int found = 0;
+  pthread_mutex_lock(&d->lock);
+  if(d->top < d->bottom && d->tasks[d->bottom-1].job == job){
+    *t = d->tasks[--d->bottom];
+    if(d->top == d->bottom) d->top = d->bottom = 0;
+    found = 1;
+  }
+  pthread_mutex_unlock(&d->lock);
+  if(found) __atomic_sub_fetch(&pool_pending, 1, __ATOMIC_ACQ_REL);
+  return found;
+}
+
+static void pool_run(pool_task t){
+  pool_job* job = t.job;
+  job->run(job->ctx, t.i);
+
+  if(job->done){
+    pthread_mutex_lock(&job->lock);
+    job->finished[t.i] = 1;
+    while(job->next < job->n && job->finished[job->next]){
+      job->done(job->ctx, job->next);
+      job->next++;
+    }
+    pthread_mutex_unlock(&job->lock);
+  }
+
+  if(job->detached){
+    free(job);
+    return;
+  }
+
+  // last thing touching job, pool_for can't return until the lock is let go
+  pthread_mutex_lock(&job->lock);
+  if(--job->left == 0) pthread_cond_signal(&job->idle);
+  pthread_mutex_unlock(&job->lock);
+}
+
+static void* pool_worker(void* arg){
+  pool_id = (int)(size_t)arg;
+  pool_task t;
+  for(;;){
+    if(pool_take(&t)){
+      pool_run(t);
+      continue;
+    }
+    pthread_mutex_lock(&pool_idle_lock);
+    while(!pool_quit && __atomic_load_n(&pool_pending, __ATOMIC_ACQUIRE) == 0)
+      pthread_cond_wait(&pool_idle, &pool_idle_lock);
+    int quit = pool_quit;
+    pthread_mutex_unlock(&pool_idle_lock);
+    if(quit) return NULL;
+  }
+}
+
+int pool_start(int n){
+  if(pool_threads > 1 || n <= 1) return pool_threads;
+
+  pool_deques = calloc(n, sizeof(pool_deque));
+  pool_tids = malloc(sizeof(pthread_t) * n);
+  for(int i = 0; i < n; i++) pthread_mutex_init(&pool_deques[i].lock, NULL);
+  pool_quit = 0;
+  pool_threads = n;
+
+  for(int i = 1; i < n; i++){
+    if(pthread_create(&pool_tids[i], NULL, pool_worker, (void*)(size_t)i) != 0){
+      // keep whatever did start, thread i's deque is never pushed to
+      pool_threads = i;
+      break;
+    }
+  }
+  return pool_threads;
+}
+
+void pool_stop(void){
+  if(pool_threads <= 1) return;
+
+  pthread_mutex_lock(&pool_idle_lock);
+  pool_quit = 1;
+  pthread_cond_broadcast(&pool_idle);
+  pthread_mutex_unlock(&pool_idle_lock);
+  for(int i = 1; i < pool_threads; i++) pthread_join(pool_tids[i], NULL);
+
+  for(int i = 0; i < pool_threads; i++){
+    pthread_mutex_destroy(&pool_deques[i].lock);
+    free(pool_deques[i].tasks);
+  }
+  free(pool_deques);
+  free(pool_tids);
+  pool_deques = NULL;
+  pool_tids = NULL;
+  pool_threads = 1;
+}
+
+int pool_size(void){ return pool_threads; }
+
+int pool_cpus(void){
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+int pool_self(void){ return pool_id; }
+
+void pool_for(int n, pool_fn run, pool_fn done, void* ctx){
+  if(pool_threads <= 1 || n <= 1){
+    for(int i = 0; i < n; i++){
+      run(ctx, i);
+      if(done) done(ctx, i);
+    }
+    return;
+  }
+
+  pool_job job = { run, done, ctx, n, n, 0, NULL, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+  if(done) job.finished = calloc(n, 1);
+
+  // pushed backwards so the owner pops them in order while thieves start from the end
+  pool_deque* d = &pool_deques[pool_id];
+  pthread_mutex_lock(&d->lock);
+  for(int i = n-1; i >= 0; i--) pool_push(d, (pool_task){ &job, i });
+  pthread_mutex_unlock(&d->lock);
+
+  pthread_mutex_lock(&pool_idle_lock);
+  __atomic_add_fetch(&pool_pending, n, __ATOMIC_ACQ_REL);
+  pthread_cond_broadcast(&pool_idle);
+  pthread_mutex_unlock(&pool_idle_lock);
+
+  // run what's left of this job here, then sleep until the tasks other threads took
+  // are finished. anything else queued is left to the workers, so a detached
+  // --serve form can't hold up the return
+  pool_task t;
+  while(pool_take_own(&job, &t)) pool_run(t);
+  pthread_mutex_lock(&job.lock);
+  while(job.left > 0) pthread_cond_wait(&job.idle, &job.lock);
+  pthread_mutex_unlock(&job.lock);
+
+  pthread_cond_destroy(&job.idle);
+  pthread_mutex_destroy(&job.lock);
+  free(job.finished);
+}
+
+void pool_submit(pool_fn run, void* ctx, int i){
+  if(pool_threads <= 1){
+    run(ctx, i);
+    return;
+  }
+
+  // no done and no waiter, so the lock and idle are never used
+  pool_job* job = calloc(1, sizeof(pool_job));
+  job->run = run;
+  job->ctx = ctx;
+  job->n = job->left = 1;
+  job->detached = 1;
+
+  // thieves take the oldest first, so workers pick these up in the order they came
+  pool_deque* d = &pool_deques[pool_id];
+  pthread_mutex_lock(&d->lock);
+  pool_push(d, (pool_task){ job, i });
+  pthread_mutex_unlock(&d->lock);
+
+  pthread_mutex_lock(&pool_idle_lock);
+  __atomic_add_fetch(&pool_pending, 1, __ATOMIC_ACQ_REL);
+  pthread_cond_signal(&pool_idle);
+  pthread_mutex_unlock(&pool_idle_lock);
+}
+
+#endif
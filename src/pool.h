@@ -0,0 +1,38 @@
+#ifndef pool_h
+#define pool_h
+
+// work stealing thread pool, every thread owns a deque of tasks and idle ones steal from the others
+
+// per thread globals, each worker gets its own copy
+#ifdef _MSC_VER
+#define POOL_LOCAL __declspec(thread)
+#else
+#define POOL_LOCAL __thread
+#endif
+
+typedef void (*pool_fn)(void* ctx, int i);
+
+// n threads in total counting the caller, which becomes thread 0. returns how many are running
+int pool_start(int n);
+void pool_stop(void);
+
+// threads in the pool, 1 when it isn't started
+int pool_size(void);
+
+// cores online, a sensible default for pool_start
+int pool_cpus(void);
+
+// index of the calling thread in the pool, 0 for the thread that started it
+int pool_self(void);
+
+// runs run(ctx, i) for every i in [0, n) across the pool and returns when all are done.
+// done, if not NULL, is called once per i in order, as soon as i and everything before it
+// has run, never from two threads at once. the caller runs the tasks nobody took yet
+// and then sleeps, it never picks up other work, so this can be called from inside a task too
+void pool_for(int n, pool_fn run, pool_fn done, void* ctx);
+
+// queues run(ctx, i) for some worker and returns right away, run has to tell the
+// caller it finished itself. runs it on the caller when there are no workers
+void pool_submit(pool_fn run, void* ctx, int i);
+
+#endif
@@ -0,0 +1,287 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simd.h"
+#include "mem.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define SIMD_ALIGN 32
+
+enum simd_levels { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+
+int simd_strict = 0;
+
+static int simd_level = -1;
+
+// resolves the best kernel set once, racing threads all pick the same one
+static int simd_resolve(void){
+  int cached = __atomic_load_n(&simd_level, __ATOMIC_RELAXED);
+  if(cached >= 0) return cached;
+
+  int level = SIMD_SCALAR;
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) level = SIMD_AVX2;
+  else if(__builtin_cpu_supports("sse2")) level = SIMD_SSE2;
+#endif
+  __atomic_store_n(&simd_level, level, __ATOMIC_RELAXED);
+  return level;
+}
+
+const char* simd_isa(void){
+  switch(simd_resolve()){
+    case SIMD_AVX2: return "avx2";
+    case SIMD_SSE2: return "sse2";
+  }
+  return "scalar";
+}
+
+// ----- scalar kernels ----- //
+
+static double simd_fold(int op, double x, double y){
+  switch(op){
+    case SIMD_ADD: return x + y;
+    case SIMD_MUL: return x * y;
+    case SIMD_MIN: return y < x ? y : x;
+    case SIMD_MAX: return y > x ? y : x;
+  }
+  return x;
+}
+
+double simd_reduce_strict(int op, double acc, const double* xs, int n){
+  switch(op){
+    case SIMD_ADD: for(int i = 0; i < n; i++) acc += xs[i]; break;
+    case SIMD_MUL: for(int i = 0; i < n; i++) acc *= xs[i]; break;
+    case SIMD_MIN: for(int i = 0; i < n; i++) acc = xs[i] < acc ? xs[i] : acc; break;
+    case SIMD_MAX: for(int i = 0; i < n; i++) acc = xs[i] > acc ? xs[i] : acc; break;
+  }
+  return acc;
+}
+
+static void simd_map_scalar(int op, double* out, const double* xs, const double* ys, int n){
+  for(int i = 0; i < n; i++) out[i] = simd_fold(op, xs[i], ys[i]);
+}
+
+static double simd_dot_scalar(const double* xs, const double* ys, int n){
+  double acc = 0;
+  for(int i = 0; i < n; i++) acc += xs[i] * ys[i];
+  return acc;
+}
+
+// ----- x86 kernels ----- //
+
+#ifdef SIMD_X86
+
+// two accumulators per kernel to hide the add/mul latency
+#define SIMD_LOOP(LOAD, W, F)                         \
+  for(; i + 2*W <= n; i += 2*W){                      \
+    a = F(a, LOAD(xs+i));                             \
+    b = F(b, LOAD(xs+i+W));                           \
+  }                                                   \
+  a = F(a, b)
+
+// min and max instructions return their second operand unless the first is
+// strictly better, so the new value goes first to keep the old one on nan and
+// on ties the way the scalar loops do
+#define SIMD_PICK_LOOP(LOAD, W, F)                    \
+  for(; i + 2*W <= n; i += 2*W){                      \
+    a = F(LOAD(xs+i), a);                             \
+    b = F(LOAD(xs+i+W), b);                           \
+  }                                                   \
+  a = F(b, a)
+
+#define SIMD_MAP_LOOP(LOAD, STORE, W, F)              \
+  for(; i + W <= n; i += W)                           \
+    STORE(out+i, F(LOAD(xs+i), LOAD(ys+i)))
+
+#define SIMD_MAP_PICK(LOAD, STORE, W, F)              \
+  for(; i + W <= n; i += W)                           \
+    STORE(out+i, F(LOAD(ys+i), LOAD(xs+i)))
+
+// min and max lanes start at the identity instead of the first loads, a nan
+// loaded there would never be replaced
+#define SIMD_PICK_INIT(SET)                           \
+  if(op == SIMD_MIN || op == SIMD_MAX){               \
+    a = b = SET(op == SIMD_MIN ? HUGE_VAL : -HUGE_VAL); \
+    i = 0;                                            \
+  }
+
+__attribute__((target("avx2")))
+static double simd_reduce_avx2(int op, double acc, const double* xs, int n){
+  if(n < 8) return simd_reduce_strict(op, acc, xs, n);
+
+  int i = 8;
+  double lanes[4];
+  __m256d a = _mm256_loadu_pd(xs);
+  __m256d b = _mm256_loadu_pd(xs+4);
+  SIMD_PICK_INIT(_mm256_set1_pd)
+
+  switch(op){
+    case SIMD_ADD: SIMD_LOOP(_mm256_loadu_pd, 4, _mm256_add_pd); break;
+    case SIMD_MUL: SIMD_LOOP(_mm256_loadu_pd, 4, _mm256_mul_pd); break;
+    case SIMD_MIN: SIMD_PICK_LOOP(_mm256_loadu_pd, 4, _mm256_min_pd); break;
+    case SIMD_MAX: SIMD_PICK_LOOP(_mm256_loadu_pd, 4, _mm256_max_pd); break;
+  }
+  _mm256_storeu_pd(lanes, a);
+
+  for(int j = 0; j < 4; j++) acc = simd_fold(op, acc, lanes[j]);
+  return simd_reduce_strict(op, acc, xs+i, n-i);
+}
+
+__attribute__((target("avx2")))
+static void simd_map_avx2(int op, double* out, const double* xs, const double* ys, int n){
+  int i = 0;
+  switch(op){
+    case SIMD_ADD: SIMD_MAP_LOOP(_mm256_loadu_pd, _mm256_storeu_pd, 4, _mm256_add_pd); break;
+    case SIMD_MUL: SIMD_MAP_LOOP(_mm256_loadu_pd, _mm256_storeu_pd, 4, _mm256_mul_pd); break;
+    case SIMD_MIN: SIMD_MAP_PICK(_mm256_loadu_pd, _mm256_storeu_pd, 4, _mm256_min_pd); break;
+    case SIMD_MAX: SIMD_MAP_PICK(_mm256_loadu_pd, _mm256_storeu_pd, 4, _mm256_max_pd); break;
+  }
+  simd_map_scalar(op, out+i, xs+i, ys+i, n-i);
+}
+
+__attribute__((target("avx2")))
+static double simd_dot_avx2(const double* xs, const double* ys, int n){
+  int i = 0;
+  double lanes[4], acc = 0;
+  __m256d a = _mm256_setzero_pd();
+
+  for(; i + 4 <= n; i += 4)
+    a = _mm256_add_pd(a, _mm256_mul_pd(_mm256_loadu_pd(xs+i), _mm256_loadu_pd(ys+i)));
+  _mm256_storeu_pd(lanes, a);
+
+  for(int j = 0; j < 4; j++) acc += lanes[j];
+  return acc + simd_dot_scalar(xs+i, ys+i, n-i);
+}
+
+__attribute__((target("sse2")))
+static double simd_reduce_sse2(int op, double acc, const double* xs, int n){
+  if(n < 4) return simd_reduce_strict(op, acc, xs, n);
+
+  int i = 4;
+  double lanes[2];
+  __m128d a = _mm_loadu_pd(xs);
+  __m128d b = _mm_loadu_pd(xs+2);
+  SIMD_PICK_INIT(_mm_set1_pd)
+
+  switch(op){
+    case SIMD_ADD: SIMD_LOOP(_mm_loadu_pd, 2, _mm_add_pd); break;
+    case SIMD_MUL: SIMD_LOOP(_mm_loadu_pd, 2, _mm_mul_pd); break;
+    case SIMD_MIN: SIMD_PICK_LOOP(_mm_loadu_pd, 2, _mm_min_pd); break;
+    case SIMD_MAX: SIMD_PICK_LOOP(_mm_loadu_pd, 2, _mm_max_pd); break;
+  }
+  _mm_storeu_pd(lanes, a);
+
+  for(int j = 0; j < 2; j++) acc = simd_fold(op, acc, lanes[j]);
+  return simd_reduce_strict(op, acc, xs+i, n-i);
+}
+
+__attribute__((target("sse2")))
+static void simd_map_sse2(int op, double* out, const double* xs, const double* ys, int n){
+  int i = 0;
+  switch(op){
+    case SIMD_ADD: SIMD_MAP_LOOP(_mm_loadu_pd, _mm_storeu_pd, 2, _mm_add_pd); break;
+    case SIMD_MUL: SIMD_MAP_LOOP(_mm_loadu_pd, _mm_storeu_pd, 2, _mm_mul_pd); break;
+    case SIMD_MIN: SIMD_MAP_PICK(_mm_loadu_pd, _mm_storeu_pd, 2, _mm_min_pd); break;
+    case SIMD_MAX: SIMD_MAP_PICK(_mm_loadu_pd, _mm_storeu_pd, 2, _mm_max_pd); break;
+  }
+  simd_map_scalar(op, out+i, xs+i, ys+i, n-i);
+}
+
+__attribute__((target("sse2")))
+static double simd_dot_sse2(const double* xs, const double* ys, int n){
+  int i = 0;
+  double lanes[2];
+  __m128d a = _mm_setzero_pd();
+
+  for(; i + 2 <= n; i += 2)
+    a = _mm_add_pd(a, _mm_mul_pd(_mm_loadu_pd(xs+i), _mm_loadu_pd(ys+i)));
+  _mm_storeu_pd(lanes, a);
+
+  return lanes[0] + lanes[1] + simd_dot_scalar(xs+i, ys+i, n-i);
+}
+
+#undef SIMD_LOOP
+#undef SIMD_PICK_LOOP
+#undef SIMD_MAP_LOOP
+#undef SIMD_MAP_PICK
+#undef SIMD_PICK_INIT
+
+#endif
+
+// ----- dispatch ----- //
+
+double simd_reduce(int op, double acc, const double* xs, int n){
+  if(simd_strict) return simd_reduce_strict(op, acc, xs, n);
+  double x = acc;
+  switch(simd_resolve()){
+#ifdef SIMD_X86
+    case SIMD_AVX2: x = simd_reduce_avx2(op, acc, xs, n); break;
+    case SIMD_SSE2: x = simd_reduce_sse2(op, acc, xs, n); break;
+#endif
+    default: return simd_reduce_strict(op, acc, xs, n);
+  }
+  // min and max match the scalar loop bit for bit except which of 0 and -0 wins,
+  // the loop keeps the first one it saw and only it knows which that was
+  if(x == 0 && (op == SIMD_MIN || op == SIMD_MAX)) return simd_reduce_strict(op, acc, xs, n);
+  return x;
+}
+
+// element-wise ops are exact, strict mode doesn't change them
+void simd_map(int op, double* out, const double* xs, const double* ys, int n){
+  switch(simd_resolve()){
+#ifdef SIMD_X86
+    case SIMD_AVX2: simd_map_avx2(op, out, xs, ys, n); return;
+    case SIMD_SSE2: simd_map_sse2(op, out, xs, ys, n); return;
+#endif
+  }
+  simd_map_scalar(op, out, xs, ys, n);
+}
+
+double simd_dot(const double* xs, const double* ys, int n){
+  if(simd_strict) return simd_dot_scalar(xs, ys, n);
+  switch(simd_resolve()){
+#ifdef SIMD_X86
+    case SIMD_AVX2: return simd_dot_avx2(xs, ys, n);
+    case SIMD_SSE2: return simd_dot_sse2(xs, ys, n);
+#endif
+  }
+  return simd_dot_scalar(xs, ys, n);
+}
+
+// ----- aligned buffers ----- //
+
+// the offset back to the raw malloc pointer is kept in the byte before the buffer
+double* simd_alloc(int n){
+  unsigned char* raw = malloc(sizeof(double) * (n > 0 ? n : 1) + SIMD_ALIGN);
+  if(!raw) return NULL;
+  unsigned char* p = raw + SIMD_ALIGN - ((size_t)raw % SIMD_ALIGN);
+  p[-1] = (unsigned char)(p - raw);
+  return (double*)p;
+}
+
+double* simd_realloc(double* p, int n){
+  if(!p) return simd_alloc(n);
+  unsigned char* raw = (unsigned char*)p - ((unsigned char*)p)[-1];
+  size_t offset = (unsigned char*)p - raw;
+  raw = realloc(raw, sizeof(double) * (n > 0 ? n : 1) + SIMD_ALIGN);
+  if(!raw) return NULL;
+
+  // realloc may move to a differently aligned address, shift the data back in line
+  unsigned char* q = raw + SIMD_ALIGN - ((size_t)raw % SIMD_ALIGN);
+  if((size_t)(q - raw) != offset) memmove(q, raw + offset, sizeof(double) * (n > 0 ? n : 1));
+  q[-1] = (unsigned char)(q - raw);
+  return (double*)q;
+}
+
+void simd_free(double* p){
+  if(p) free((unsigned char*)p - ((unsigned char*)p)[-1]);
+}
+
+size_t simd_size(double* p){
+  return p ? mem_block((unsigned char*)p - ((unsigned char*)p)[-1]) : 0;
+}
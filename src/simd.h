@@ -0,0 +1,36 @@
+#ifndef simd_h
+#define simd_h
+
+#include <stddef.h>
+
+// kernels over contiguous doubles, the isa is picked at runtime
+enum simd_ops { SIMD_ADD, SIMD_MUL, SIMD_MIN, SIMD_MAX };
+
+// strict left-to-right float ordering, bit exact with a serial loop (--strict-fp)
+extern int simd_strict;
+
+// folds xs[0..n) into acc with op, lanes are combined in whatever order is fastest.
+// min and max still give exactly what the left to right loop does, nan and -0 included
+double simd_reduce(int op, double acc, const double* xs, int n);
+
+// same as simd_reduce but always left to right
+double simd_reduce_strict(int op, double acc, const double* xs, int n);
+
+// out[i] = xs[i] op ys[i], out may alias xs or ys
+void simd_map(int op, double* out, const double* xs, const double* ys, int n);
+
+// sum of xs[i] * ys[i]
+double simd_dot(const double* xs, const double* ys, int n);
+
+// 32 byte aligned buffers for packed vectors
+double* simd_alloc(int n);
+double* simd_realloc(double* p, int n);
+void simd_free(double* p);
+
+// bytes malloc reserved for the buffer at p, see mem_block
+size_t simd_size(double* p);
+
+// name of the kernel set in use: "avx2", "sse2" or "scalar"
+const char* simd_isa(void);
+
+#endif